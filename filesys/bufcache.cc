@@ -0,0 +1,322 @@
+// bufcache.cc
+//	Routines to cache data sectors, and to read them ahead.
+//
+//	Reads, hits and sectors read ahead are counted in "stats", and
+//	reported by Statistics::Print.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "bufcache.h"
+
+//----------------------------------------------------------------------
+// ReadAheadThread
+// 	Start up the read-ahead thread.  Need this to be a C routine,
+//	because C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ReadAheadThread(_int arg)
+{
+    BufferCache *cache = (BufferCache *)arg;
+    cache->ReadAheadThread();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize an empty cache, and fork the thread that does the
+//	reading ahead.
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache()
+{
+    Thread *t;
+
+    for (int i = 0; i < BufferHashSize; i++)
+        table[i] = NULL;
+    for (int i = 0; i < NumBuffers; i++)
+    {
+        buffers[i].sector = -1;
+        buffers[i].state = BufferEmpty;
+        buffers[i].lastUse = 0;
+        buffers[i].next = NULL;
+    }
+    useCount = 0;
+    lock = new Lock("buffer cache");
+    ready = new Condition("buffer ready");
+    work = new Condition("read-ahead queued");
+
+    t = new Thread("read-ahead");
+    t->Fork(::ReadAheadThread, (_int)this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	De-allocate the cache.  Nachos is halting, so the read-ahead
+//	thread will never run again.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    delete work;
+    delete ready;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSector
+// 	Copy the contents of "sector" into "data", reading it from disk
+//	only if it isn't cached.  If read-ahead is already reading it,
+//	just wait for that to finish.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSector(int sector, char *data)
+{
+    ReadPart(sector, 0, data, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadPart
+// 	Like ReadSector, but copy only the "numBytes" bytes at "offset"
+//	within the sector, straight out of the cache.  This spares a
+//	reader that wants part of a sector a bounce buffer of its own.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadPart(int sector, int offset, char *data, int numBytes)
+{
+    Buffer *buf;
+
+    ASSERT(offset >= 0 && numBytes >= 0 && offset + numBytes <= SectorSize);
+
+    lock->Acquire();
+    stats->numBufferReads++;
+    for (;;)
+    {
+        buf = Find(sector);
+        if (buf == NULL)
+            buf = GetFree(sector, TRUE);
+        if (buf == NULL || buf->state == BufferReading)
+        {
+            ready->Wait(lock); // every buffer is busy, or ours is
+            continue;
+        }
+        break;
+    }
+    if (buf->state == BufferValid || buf->state == BufferWriting)
+        stats->numBufferHits++;
+    else
+    { // fresh, or queued but not started yet: read it ourselves
+        buf->state = BufferReading;
+        lock->Release();
+        synchDisk->ReadSector(sector, buf->data);
+        lock->Acquire();
+        buf->state = BufferValid;
+        ready->Broadcast(lock);
+    }
+    buf->lastUse = ++useCount;
+    bcopy(&buf->data[offset], data, numBytes);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteSector
+// 	Write "data" to "sector", keeping a copy in the cache.  The disk
+//	is written in any case (the cache is write-through).
+//
+//	The buffer stays busy until the disk has the data: were it
+//	replaced meanwhile, a reader could cache what the disk held before.
+//	Readers can still take the new contents from it.
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteSector(int sector, char *data)
+{
+    Buffer *buf;
+
+    lock->Acquire();
+    for (;;)
+    {
+        buf = Find(sector);
+        if (buf == NULL)
+            buf = GetFree(sector, TRUE);
+        if (buf == NULL || buf->state == BufferReading ||
+            buf->state == BufferWriting)
+        { // every buffer is busy, or the disk isn't done with ours
+            ready->Wait(lock);
+            continue;
+        }
+        break;
+    }
+    bcopy(data, buf->data, SectorSize);
+    buf->state = BufferWriting;
+    buf->lastUse = ++useCount;
+    lock->Release();
+    synchDisk->WriteSector(sector, data);
+    lock->Acquire();
+    buf->state = BufferValid;
+    ready->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAhead
+// 	Queue the "count" sectors in "sectors" to be read in by the
+//	read-ahead thread, skipping those already cached.  Gives up
+//	(quietly -- it is only a hint) when there are no buffers left
+//	that aren't busy.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAhead(int *sectors, int count)
+{
+    Buffer *buf;
+    bool queued = FALSE;
+
+    lock->Acquire();
+    for (int i = 0; i < count; i++)
+    {
+        if (Find(sectors[i]) != NULL)
+            continue;
+        if ((buf = GetFree(sectors[i], FALSE)) == NULL)
+            break;
+        buf->state = BufferQueued;
+        buf->lastUse = ++useCount;
+        stats->numReadAheads++;
+        queued = TRUE;
+    }
+    if (queued)
+        work->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Invalidate
+// 	"sector" has been freed, and may be reused for anything; drop our
+//	copy of it (after any read in progress is done with the buffer).
+//----------------------------------------------------------------------
+
+void
+BufferCache::Invalidate(int sector)
+{
+    Buffer *buf;
+
+    lock->Acquire();
+    while ((buf = Find(sector)) != NULL && (buf->state == BufferReading ||
+                                            buf->state == BufferWriting))
+        ready->Wait(lock);
+    if (buf != NULL)
+    {
+        Unhash(buf);
+        buf->sector = -1;
+        buf->state = BufferEmpty;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAheadThread
+// 	Forever read in queued sectors, oldest request first, sleeping
+//	while there are none.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAheadThread()
+{
+    Buffer *buf;
+
+    lock->Acquire();
+    for (;;)
+    {
+        buf = NULL;
+        for (int i = 0; i < NumBuffers; i++)
+            if (buffers[i].state == BufferQueued &&
+                (buf == NULL || buffers[i].lastUse < buf->lastUse))
+                buf = &buffers[i];
+        if (buf == NULL)
+        {
+            work->Wait(lock);
+            continue;
+        }
+        buf->state = BufferReading;
+        lock->Release();
+        DEBUG('f', "Reading ahead sector %d.\n", buf->sector);
+        synchDisk->ReadSector(buf->sector, buf->data);
+        lock->Acquire();
+        buf->state = BufferValid;
+        ready->Broadcast(lock);
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Find
+// 	Return the buffer holding (or about to hold) "sector", or NULL.
+//----------------------------------------------------------------------
+
+Buffer *
+BufferCache::Find(int sector)
+{
+    Buffer *buf = table[sector % BufferHashSize];
+
+    while (buf != NULL && buf->sector != sector)
+        buf = buf->next;
+    return buf;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::GetFree
+// 	Take the least recently used buffer that isn't busy -- being read
+//	or written -- (an empty one if there is any), and hand it over to
+//	"sector", with its state left for the caller to set.  If "steal",
+//	a buffer only queued for read-ahead counts as not busy.  Return
+//	NULL if there is none.
+//----------------------------------------------------------------------
+
+Buffer *
+BufferCache::GetFree(int sector, bool steal)
+{
+    Buffer *victim = NULL;
+
+    for (int i = 0; i < NumBuffers; i++)
+    {
+        Buffer *buf = &buffers[i];
+        if (buf->state == BufferReading || buf->state == BufferWriting ||
+            (buf->state == BufferQueued && !steal))
+            continue;
+        if (buf->state == BufferEmpty)
+        {
+            victim = buf;
+            break;
+        }
+        if (victim == NULL || buf->lastUse < victim->lastUse)
+            victim = buf;
+    }
+    if (victim == NULL)
+        return NULL;
+    if (victim->sector != -1)
+        Unhash(victim);
+    victim->sector = sector;
+    victim->state = BufferEmpty;
+    victim->next = table[sector % BufferHashSize];
+    table[sector % BufferHashSize] = victim;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unhash
+// 	Take "buf" out of the hash chain of the sector it holds.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unhash(Buffer *buf)
+{
+    Buffer **link = &table[buf->sector % BufferHashSize];
+
+    while (*link != buf)
+        link = &(*link)->next;
+    *link = buf->next;
+}
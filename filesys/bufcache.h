@@ -0,0 +1,94 @@
+// bufcache.h
+//	Data structures for a cache of file data sectors (in UNIX terms,
+//	the buffer cache), with asynchronous read-ahead.
+//
+//	OpenFile reads and writes the data sectors of ordinary files
+//	through the cache.  Writes also go straight through to the disk,
+//	so the cache never holds anything newer than the disk, and any
+//	buffer that isn't being read into can be reused at any time.
+//	Metadata (headers, index blocks, the bitmap and directories)
+//	does not go through the cache: it has the journal instead.
+//
+//	ReadAhead only queues sectors; a kernel thread of the cache's own
+//	reads them in, while the thread that asked gets on with its work.
+//	A sector that is wanted before the thread got to it is simply read
+//	on the spot.
+//
+//	The data sectors of a removed file must be invalidated before they
+//	are reused, so that a stale copy is never found.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+#include "disk.h"
+#include "synch.h"
+
+#define NumBuffers 64		// sectors the cache holds
+#define BufferHashSize 32	// hash chains in the cache
+
+// Read-ahead window of a sequentially read file, in sectors: it starts
+// at MinReadAhead, doubles on every batch up to MaxReadAhead, and is
+// dropped on a seek (cf. OpenFile::ReadAhead).
+#define MinReadAhead 2
+#define MaxReadAhead 16
+
+enum BufferState { BufferEmpty, BufferQueued, BufferReading, BufferWriting,
+                   BufferValid };
+
+// The following class defines a buffer: the cached copy of one sector.
+class Buffer {
+  public:
+    int sector;			// Which sector this is a copy of
+    BufferState state;		// Queued: wanted by read-ahead;
+				// Reading: the disk is filling it in;
+				// Writing: valid, and being written
+    int lastUse;		// For LRU replacement (and, while
+				// queued, the order of requests)
+    Buffer *next;		// Next buffer in the same hash chain
+    char data[SectorSize];	// The contents of the sector
+};
+
+class BufferCache {
+  public:
+    BufferCache();		// Initialize an empty cache, and start
+				// the read-ahead thread
+    ~BufferCache();		// De-allocate the cache
+
+    void ReadSector(int sector, char *data);
+				// Read a data sector, from the cache if
+				// it is there
+    void ReadPart(int sector, int offset, char *data, int numBytes);
+				// Read only part of a data sector
+    void WriteSector(int sector, char *data);
+				// Write a data sector, to the cache and
+				// to the disk
+    void ReadAhead(int *sectors, int count);
+				// Queue sectors to be read in the
+				// background (as many as there is room)
+    void Invalidate(int sector);// "sector" has been freed; forget it
+
+    void ReadAheadThread();	// Body of the read-ahead thread
+
+  private:
+    Buffer buffers[NumBuffers];
+    Buffer *table[BufferHashSize];
+    int useCount;		// Ticks on every use, for LRU
+    Lock *lock;			// Protects everything above
+    Condition *ready;		// Signalled when a read finishes
+    Condition *work;		// Signalled when read-ahead is queued
+
+    Buffer *Find(int sector);	// Buffer for "sector", or NULL
+    Buffer *GetFree(int sector, bool steal);
+				// Reuse the least recently used buffer
+				// for "sector"; if "steal", queued
+				// read-ahead may be dropped for it
+    void Unhash(Buffer *buf);	// Take a buffer out of its chain
+};
+
+#endif // BUFCACHE_H
@@ -11,10 +11,12 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	The table grows (doubling) when all of its entries are used, and
+//	the directory file grows with it on the next WriteBack.  The first
+//	growth only takes as many entries as fit in the file header, so
+//	that a small directory keeps its entries there (cf. InlineSize).  Names are
+//	found through hash chains threaded through the table, rebuilt
+//	whenever the table is read in or resized.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +27,33 @@
 #include "filehdr.h"
 #include "directory.h"
 
+//----------------------------------------------------------------------
+// GrownSize
+// 	Return how many entries a full table of "tableSize" entries grows
+//	to: twice as many, or, from none, as many as fit in the header.
+//----------------------------------------------------------------------
+
+static int
+GrownSize(int tableSize)
+{
+    return tableSize > 0 ? 2 * tableSize : InlineSize / (int)sizeof(DirectoryEntry);
+}
+
+//----------------------------------------------------------------------
+// HashName
+// 	Hash a file name (at most FileNameMaxLen characters of it).
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name)
+{
+    unsigned int h = 5381;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	h = h * 33 + (unsigned char)name[i];
+    return h;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -37,10 +66,15 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    tableSize = 0;
+    table = NULL;
+    hashSize = 0;
+    hashHead = NULL;
+    hashNext = NULL;
+    numChunks = 0;
+    dirtyChunks = NULL;
+    firstFree = 0;
+    Resize(size);
 }
 
 //----------------------------------------------------------------------
@@ -49,13 +83,17 @@ Directory::Directory(int size)
 //----------------------------------------------------------------------
 
 Directory::~Directory()
-{ 
+{
     delete [] table;
-} 
+    delete [] hashHead;
+    delete [] hashNext;
+    delete [] dirtyChunks;
+}
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The table takes
+//	the size of the directory file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,20 +101,87 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    delete [] table;			// start over at the file's size
+    delete [] dirtyChunks;
+    table = NULL;
+    dirtyChunks = NULL;
+    tableSize = numChunks = 0;
+    Resize(size);
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    for (int i = 0; i < numChunks; i++)
+	dirtyChunks[i] = FALSE;
+    firstFree = 0;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only the
+//	sectors holding changed entries are written, each run of them
+//	with one WriteAt; entries past the end of the file extend it.
+//
+//	Return FALSE if the file could not be extended (the disk is
+//	full); the sectors not written stay dirty, for the next try.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = tableSize * sizeof(DirectoryEntry);
+
+    for (int i = 0; i < numChunks; ) {
+	if (!dirtyChunks[i]) {
+	    i++;
+	    continue;
+	}
+	int first = i;
+	while (i < numChunks && dirtyChunks[i])
+	    i++;
+	int from = first * SectorSize;
+	int to = min(i * SectorSize, size);
+	if (file->WriteAt((char *)table + from, to - from, from) != to - from)
+	    return FALSE;
+	for (int j = first; j < i; j++)
+	    dirtyChunks[j] = FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::DirtySectors
+// 	Return how many sectors of the directory file WriteBack would
+//	write, so that the file system can make room for them in the
+//	journal first.
+//----------------------------------------------------------------------
+
+int
+Directory::DirtySectors()
+{
+    int count = 0;
+
+    for (int i = 0; i < numChunks; i++)
+	if (dirtyChunks[i])
+	    count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Directory::SizeAfterAdd
+// 	Return how many bytes the directory file must hold once one more
+//	name is added: more than now if the table has to grow for it.
+//----------------------------------------------------------------------
+
+int
+Directory::SizeAfterAdd()
+{
+    for (int i = firstFree; i < tableSize; i++)
+	if (!table[i].inUse)
+	    return tableSize * sizeof(DirectoryEntry);
+    return GrownSize(tableSize) * sizeof(DirectoryEntry);
 }
 
 //----------------------------------------------------------------------
@@ -90,8 +195,9 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    for (int i = hashHead[HashName(name) & (hashSize - 1)]; i != -1;
+	 i = hashNext[i])
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
 }
@@ -99,7 +205,7 @@ Directory::FindIndex(char *name)
 //----------------------------------------------------------------------
 // Directory::Find
 // 	Look up file name in directory, and return the disk sector number
-//	where the file's header is stored. Return -1 if the name isn't 
+//	where the file's header is stored. Return -1 if the name isn't
 //	in the directory.
 //
 //	"name" -- the file name to look up
@@ -115,55 +221,99 @@ Directory::Find(char *name)
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsDir
+// 	Return TRUE if "name" is in the directory and is itself a
+//	directory.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDir(char *name)
+{
+    int i = FindIndex(name);
+
+    return (bool)(i != -1 && table[i].isDir);
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.
+//	If the directory is full, the table is doubled first.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDir" -- is the new entry a directory?
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
-{ 
+Directory::Add(char *name, int newSector, bool isDir)
+{
+    int i;
+
     if (FindIndex(name) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    for (i = firstFree; i < tableSize; i++)
+        if (!table[i].inUse)
+	    break;
+    if (i == tableSize)
+	Resize(GrownSize(tableSize));
+    firstFree = i + 1;
+
+    table[i].inUse = TRUE;
+    table[i].isDir = isDir;
+    strncpy(table[i].name, name, FileNameMaxLen);
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    HashInsert(i);
+    MarkDirty(i);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Remove
 // 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
+//	return FALSE if the file isn't in the directory.
 //
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
 bool
 Directory::Remove(char *name)
-{ 
+{
     int i = FindIndex(name);
 
     if (i == -1)
 	return FALSE; 		// name not in directory
+    HashRemove(i);
     table[i].inUse = FALSE;
-    return TRUE;	
+    MarkDirty(i);
+    if (i < firstFree)
+	firstFree = i;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if no entry of the directory is in use.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    return FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory. 
+// 	List all the file names in the directory, with a trailing '/'
+//	on the names of subdirectories.
 //----------------------------------------------------------------------
 
 void
@@ -171,7 +321,7 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, table[i].isDir ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -182,16 +332,131 @@ Directory::List()
 
 void
 Directory::Print()
-{ 
+{
     FileHeader *hdr = new FileHeader;
 
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
+	    printf("Name: %s%s, Sector: %d\n", table[i].name,
+		   table[i].isDir ? "/" : "", table[i].sector);
 	    hdr->FetchFrom(table[i].sector);
 	    hdr->Print();
 	}
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// Directory::NumEntries/Entry
+// 	Give callers (such as the file system, when it walks the tree of
+//	directories) access to the table, one entry at a time.
+//----------------------------------------------------------------------
+
+int
+Directory::NumEntries()
+{
+    return tableSize;
+}
+
+DirectoryEntry *
+Directory::Entry(int i)
+{
+    ASSERT(i >= 0 && i < tableSize);
+    return &table[i];
+}
+
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Grow the table to "newSize" entries.  The new entries are free,
+//	and are marked dirty so that WriteBack extends the file.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int newSize)
+{
+    DirectoryEntry *newTable = new DirectoryEntry[newSize];
+    int newChunks = divRoundUp(newSize * sizeof(DirectoryEntry), SectorSize);
+    bool *newDirty = new bool[newChunks];
+
+    ASSERT(newSize >= tableSize);
+    for (int i = 0; i < tableSize; i++)
+	newTable[i] = table[i];
+    for (int i = tableSize; i < newSize; i++) {
+	newTable[i].inUse = FALSE;
+	newTable[i].isDir = FALSE;
+	newTable[i].sector = -1;
+	newTable[i].name[0] = '\0';
+    }
+    for (int i = 0; i < newChunks; i++)
+	newDirty[i] = (bool)(i >= numChunks || dirtyChunks[i]);
+    if (numChunks > 0 && tableSize * sizeof(DirectoryEntry) % SectorSize != 0)
+	newDirty[numChunks - 1] = TRUE;	// last sector gained entries
+
+    delete [] table;
+    delete [] dirtyChunks;
+    table = newTable;
+    dirtyChunks = newDirty;
+    tableSize = newSize;
+    numChunks = newChunks;
+    Rehash();
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Size the hash table to the directory (at least one chain per
+//	entry) and put every entry in use on its chain.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    delete [] hashHead;
+    delete [] hashNext;
+    for (hashSize = 1; hashSize < tableSize; hashSize *= 2)
+	;
+    hashHead = new int[hashSize];
+    hashNext = new int[max(tableSize, 1)];
+    for (int i = 0; i < hashSize; i++)
+	hashHead[i] = -1;
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    HashInsert(i);
+}
+
+//----------------------------------------------------------------------
+// Directory::HashInsert/HashRemove
+// 	Put entry "i" on, or take it off, the chain for its name.
+//----------------------------------------------------------------------
+
+void
+Directory::HashInsert(int i)
+{
+    int h = HashName(table[i].name) & (hashSize - 1);
+
+    hashNext[i] = hashHead[h];
+    hashHead[h] = i;
+}
+
+void
+Directory::HashRemove(int i)
+{
+    int *link = &hashHead[HashName(table[i].name) & (hashSize - 1)];
+
+    while (*link != i) {
+	ASSERT(*link != -1);
+	link = &hashNext[*link];
+    }
+    *link = hashNext[i];
+}
+
+//----------------------------------------------------------------------
+// Directory::MarkDirty
+// 	Remember that the sector holding entry "i" has to be written back.
+//----------------------------------------------------------------------
+
+void
+Directory::MarkDirty(int i)
+{
+    dirtyChunks[i * sizeof(DirectoryEntry) / SectorSize] = TRUE;
+}
@@ -1,15 +1,21 @@
-// directory.h 
+// directory.h
 //	Data structures to manage a UNIX-like directory of file names.
-// 
+//
 //      A directory is a table of pairs: <file name, sector #>,
-//	giving the name of each file in the directory, and 
+//	giving the name of each file in the directory, and
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  An entry can
+//	also name another directory, which is how the file system
+//	builds its tree of directories.
+//
+//	On disk the table is just an array of entries, so a directory
+//	file can grow one entry at a time.  In memory, a hash table over
+//	the names makes lookups independent of the size of the directory.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
-// All rights reserved.  See copyright.h for copyright notice and limitation 
+// All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
@@ -19,8 +25,10 @@
 
 #include "openfile.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		23	// for simplicity, we assume
+					// file names are <= 23 characters long
+					// (so that an entry is 32 bytes, and
+					// a sector holds a whole number of them)
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,9 +40,10 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
-    int sector;				// Location on disk to find the 
-					//   FileHeader for this file 
-    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
+    bool isDir;				// Is the entry itself a directory?
+    int sector;				// Location on disk to find the
+					//   FileHeader for this file
+    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for
 					// the trailing '\0'
 };
 
@@ -46,7 +55,8 @@ class DirectoryEntry {
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  WriteBack only writes the sectors of the directory
+// file that hold changed entries; the file grows when the table does.
 
 class Directory {
   public:
@@ -55,15 +65,22 @@ class Directory {
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
+    bool WriteBack(OpenFile *file);	// Write modifications to
 					// directory contents back to disk
+    int DirtySectors();			// Sectors WriteBack would write
+    int SizeAfterAdd();			// Bytes the file needs once one
+					// more name is added
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name);		// Find the sector number of the
 					// FileHeader for file: "name"
+    bool IsDir(char *name);		// Is "name" a subdirectory?
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector, bool isDir = FALSE);
+					// Add a file name into the directory,
+					// growing the table if it is full
 
     bool Remove(char *name);		// Remove a file from the directory
+    bool IsEmpty();			// No names in the directory?
 
     void List();			// Print the names of all the files
 					//  in the directory
@@ -71,13 +88,30 @@ class Directory {
 					//  of the directory -- all the file
 					//  names and their contents.
 
+    int NumEntries();			// Size of the table, and the entry
+    DirectoryEntry *Entry(int i);	// at index "i", for walking it
+
   private:
     int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
+    DirectoryEntry *table;		// Table of pairs:
+					// <file name, file header location>
+    int firstFree;			// No free entry before this index
+
+    int hashSize;			// Number of hash chains (power of 2)
+    int *hashHead;			// First entry of each chain, or -1
+    int *hashNext;			// Next entry in the same chain
+
+    int numChunks;			// Sectors of the directory file
+    bool *dirtyChunks;			// Sector changed since last
+					// FetchFrom/WriteBack?
 
-    int FindIndex(char *name);		// Find the index into the directory 
+    int FindIndex(char *name);		// Find the index into the directory
 					//  table corresponding to "name"
+    void Resize(int newSize);		// Grow the table to "newSize" entries
+    void Rehash();			// Rebuild the hash chains
+    void HashInsert(int i);		// Put entry "i" on its chain
+    void HashRemove(int i);		// Take entry "i" off its chain
+    void MarkDirty(int i);		// Entry "i" must be written back
 };
 
 #endif // DIRECTORY_H
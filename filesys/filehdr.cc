@@ -3,12 +3,25 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector,
+//	file's data is stored.  As in UNIX, the header holds a small
+//	table of direct pointers to the first few data sectors, followed
+//	by one single, one double and one triple indirect pointer.  An
+//	index block is a sector full of sector numbers; a level-N index
+//	block points at level-(N-1) index blocks, and a level-1 block
+//	points at data sectors.  The table size is chosen so that the
+//	file header will be just big enough to fit in one disk sector,
+//
+//	Looking up a sector touches at most IndexLevels index blocks, and
+//	those are cached in memory (as a tree mirroring the on-disk one)
+//	for as long as the header is, so repeated lookups cost no I/O.
+//	Files only ever grow, one data sector at a time, in order; that
+//	is the single path used both by Allocate and by addLength.
+//
+//	A file of no more than InlineSize bytes has no data sectors at
+//	all: its bytes are stored where the sector pointers would be.
+//	Such a file has numSectors == 0 (any other file with data has at
+//	least one sector), and when it grows past InlineSize its data is
+//	moved out to a data sector of its own.
 //
 //      Unlike in a real system, we do not keep track of file permissions,
 //	ownership, last modification date, etc., in the file header.
@@ -27,6 +40,98 @@
 #include "system.h"
 #include "filehdr.h"
 
+//----------------------------------------------------------------------
+// IndexSpan
+// 	Number of data sectors reachable through one level-"level" index
+//	block (NumIndirect to the power "level").
+//----------------------------------------------------------------------
+
+static int
+IndexSpan(int level)
+{
+    int span = 1;
+
+    for (int i = 0; i < level; i++)
+        span *= NumIndirect;
+    return span;
+}
+
+//----------------------------------------------------------------------
+// IndexBlocksUnder
+// 	Number of index blocks needed to map "count" data sectors through
+//	a level-"level" index block (counting that block itself).
+//----------------------------------------------------------------------
+
+static int
+IndexBlocksUnder(int level, int count)
+{
+    int blocks = 1;
+    int span = IndexSpan(level - 1);
+
+    if (level > 1)
+        for (; count > 0; count -= span)
+            blocks += IndexBlocksUnder(level - 1, min(count, span));
+    return blocks;
+}
+
+//----------------------------------------------------------------------
+// IndexBlocksFor
+// 	Number of index blocks a file of "sectors" data sectors needs.
+//----------------------------------------------------------------------
+
+static int
+IndexBlocksFor(int sectors)
+{
+    int blocks = 0;
+
+    sectors -= NumDirect;
+    for (int level = 1; level <= IndexLevels && sectors > 0; level++)
+    {
+        int count = min(sectors, IndexSpan(level));
+        blocks += IndexBlocksUnder(level, count);
+        sectors -= count;
+    }
+    return blocks;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorsFor
+// 	Return how many sectors, counting index blocks, a file of
+//	"fileSize" bytes takes up on disk (not counting its header).
+//	Growing a file from one size to another takes the difference.
+//----------------------------------------------------------------------
+
+int FileHeader::SectorsFor(int fileSize)
+{
+    int sectors = divRoundUp(fileSize, SectorSize);
+
+    if (fileSize <= InlineSize)
+        return 0; // kept in the header
+    return sectors + IndexBlocksFor(sectors);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize the in-memory part of a file header.  The on-disk part
+//	is filled in later, by Allocate or FetchFrom.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    for (int i = 0; i < IndexLevels; i++)
+        indexCache[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate any index blocks we have cached in memory.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    InvalidateIndexCache();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -34,118 +139,270 @@
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	A file small enough is given no data blocks, and its data (all
+//	zeroes) is kept in the header.
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
 //----------------------------------------------------------------------
 
 bool FileHeader::Allocate(BitMap *freeMap, int fileSize)
 {
-    numBytes = fileSize;
-    numSectors = divRoundUp(fileSize, SectorSize);
-    if (numSectors > NumFirst) //需要二级索引
-        return AllocateWithIndex(freeMap, fileSize);
-    useIndex = false;
-    if (freeMap->NumClear() < numSectors)
+    InvalidateIndexCache();
+    numBytes = 0;
+    numSectors = 0;
+    for (int i = 0; i < IndexLevels; i++)
+        indirect[i] = -1;
+    if (fileSize <= InlineSize)
+    {
+        bzero((char *)dataSectors, InlineSize);
+        numBytes = fileSize;
+        return TRUE;
+    }
+    if (!Extend(freeMap, divRoundUp(fileSize, SectorSize)))
         return FALSE; // not enough space
-
-    for (int i = 0; i < numSectors; i++)
-        dataSectors[i] = freeMap->Find();
+    numBytes = fileSize;
     return TRUE;
 }
 
-bool FileHeader::AllocateWithIndex(BitMap *freeMap, int fileSize)
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Map data sectors numSectors .. newNumSectors-1, allocating them
+//	(and whatever index blocks they need) out of "freeMap".  Index
+//	blocks that were created or changed are written to disk; the
+//	header itself is not.  Return FALSE, changing nothing, if the
+//	disk does not have room or the file would get too large.
+//
+//	The new data sectors are taken as one contiguous run, right after
+//	the file's current last sector if possible; only if the disk is
+//	too fragmented for that are they picked one at a time.
+//----------------------------------------------------------------------
+
+bool FileHeader::Extend(BitMap *freeMap, int newNumSectors)
 {
-    useIndex = true;
-    numBytes = fileSize;
-    numSectors = divRoundUp(fileSize, SectorSize);
-    int numNode = divRoundUp(numSectors, NumSecond);
-    if (freeMap->NumClear() < numSectors + numNode)
-        return FALSE; // not enough space
-    for (int i = 0; i < numNode; i++)
+    int needed = newNumSectors - numSectors +
+                 IndexBlocksFor(newNumSectors) - IndexBlocksFor(numSectors);
+    int next, sector;
+
+    if (newNumSectors > MaxFileSectors || freeMap->NumClear() < needed)
+        return FALSE;
+    if (newNumSectors == numSectors)
+        return TRUE;
+    next = freeMap->FindContiguous(newNumSectors - numSectors,
+                                   numSectors > 0 ? SectorOf(numSectors - 1) + 1 : 0);
+    for (; numSectors < newNumSectors; numSectors++)
     {
-        int sector = freeMap->Find();
-        dataSectors[i] = sector;
-        SecondNode *node = new SecondNode;
-        if (i < numNode - 1)
-            for (int j = 0; j < NumSecond; j++)
-                node->dataSectors[j] = freeMap->Find();
-        else
-            for (int j = 0; j < numSectors - NumSecond * (numNode - 1); j++)
-                node->dataSectors[j] = freeMap->Find();
-        synchDisk->WriteSector(sector, (char *)node); //保存二级节点
-        delete node;
+        int which = numSectors;
+        sector = (next != -1) ? next++ : freeMap->Find();
+        if (which < NumDirect)
+        {
+            dataSectors[which] = sector;
+            continue;
+        }
+        which -= NumDirect;
+        for (int level = 1; level <= IndexLevels; level++)
+        {
+            if (which < IndexSpan(level))
+            {
+                int slot;
+                CachedIndex *index = WalkIndex(level, which, freeMap, &slot);
+                index->node.dataSectors[slot] = sector;
+                index->dirty = TRUE;
+                break;
+            }
+            which -= IndexSpan(level);
+        }
     }
+    for (int i = 0; i < IndexLevels; i++)
+        FlushIndex(indexCache[i]);
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
+//	The buffer cache forgets the data sectors, which may now be reused.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
 
 void FileHeader::Deallocate(BitMap *freeMap)
 {
-    if (useIndex)
-    {
-        DeallocateWithIndex(freeMap);
-        return;
-    }
-    for (int i = 0; i < numSectors; i++)
+    int remaining = numSectors;
+
+    for (int i = 0; i < NumDirect && i < numSectors; i++)
     {
         ASSERT(freeMap->Test((int)dataSectors[i])); // ought to be marked!
         freeMap->Clear((int)dataSectors[i]);
+        bufferCache->Invalidate((int)dataSectors[i]);
+    }
+    remaining -= NumDirect;
+    for (int level = 1; level <= IndexLevels && remaining > 0; level++)
+    {
+        int count = min(remaining, IndexSpan(level));
+        DeallocateIndex(freeMap, &indexCache[level - 1], indirect[level - 1],
+                        level, count);
+        remaining -= count;
     }
 }
 
-void FileHeader::DeallocateWithIndex(BitMap *freeMap)
+//----------------------------------------------------------------------
+// FileHeader::DeallocateIndex
+// 	Free the "count" data sectors below a level-"level" index block,
+//	the index blocks in between, and the block itself.
+//----------------------------------------------------------------------
+
+void FileHeader::DeallocateIndex(BitMap *freeMap, CachedIndex **link,
+                                 int sector, int level, int count)
 {
-    int numNode = divRoundUp(numSectors, NumSecond); //索引节点数量
-    for (int i = 0; i < numNode; i++)
+    CachedIndex *index = GetIndex(link, &sector, FALSE, NULL);
+    int span = IndexSpan(level - 1);
+
+    for (int i = 0; count > 0; i++, count -= span)
     {
-        SecondNode *snode = new SecondNode;
-        synchDisk->ReadSector(dataSectors[i], (char *)snode);
-        if (i < numNode - 1)
-            for (int j = 0; j < NumSecond; j++)
-            {
-                ASSERT(freeMap->Test((int)snode->dataSectors[j]));
-                freeMap->Clear((int)snode->dataSectors[j]);
-            }
+        if (level == 1)
+        {
+            ASSERT(freeMap->Test(index->node.dataSectors[i]));
+            freeMap->Clear(index->node.dataSectors[i]);
+            bufferCache->Invalidate(index->node.dataSectors[i]);
+        }
         else
-            for (int j = 0; j < numSectors - NumSecond * (numNode - 1); j++)
-            {
-                ASSERT(freeMap->Test((int)snode->dataSectors[j]));
-                freeMap->Clear((int)snode->dataSectors[j]);
-            }
-        ASSERT(freeMap->Test((int)dataSectors[i]));
-        freeMap->Clear((int)dataSectors[i]);
-        delete snode;
+            DeallocateIndex(freeMap, &index->child[i],
+                            index->node.dataSectors[i], level - 1,
+                            min(count, span));
+    }
+    ASSERT(freeMap->Test(index->sector));
+    freeMap->Clear(index->sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllSectors
+// 	Store in "sectors" every sector the file takes up on disk: its data
+//	sectors and its index blocks (not its header).  "sectors" must have
+//	room for SectorsFor(FileLength()) entries.  Return how many were
+//	stored, or -1 if the header, or an index block, makes no sense (a
+//	length that doesn't match, or a sector that is not on the disk), so
+//	that the file system checker can tell a damaged file.
+//----------------------------------------------------------------------
+
+int FileHeader::AllSectors(int *sectors)
+{
+    int remaining = numSectors;
+    int numListed = 0;
+
+    if (numBytes < 0 || numSectors > MaxFileSectors ||
+        (numSectors != divRoundUp(numBytes, SectorSize) &&
+         !(numSectors == 0 && numBytes <= InlineSize)))
+        return -1;
+    for (int i = 0; i < NumDirect && i < numSectors; i++)
+    {
+        if (dataSectors[i] < 0 || dataSectors[i] >= NumSectors)
+            return -1;
+        sectors[numListed++] = dataSectors[i];
+    }
+    remaining -= NumDirect;
+    for (int level = 1; level <= IndexLevels && remaining > 0; level++)
+    {
+        int count = min(remaining, IndexSpan(level));
+        if (!ListIndex(&indexCache[level - 1], indirect[level - 1], level,
+                       count, sectors, &numListed))
+            return -1;
+        remaining -= count;
     }
+    return numListed;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ListIndex
+// 	The part of AllSectors below one level-"level" index block, which
+//	maps "count" data sectors: add the block itself and everything
+//	below it to "sectors".  Return FALSE if a sector is off the disk.
+//----------------------------------------------------------------------
+
+bool FileHeader::ListIndex(CachedIndex **link, int sector, int level,
+                           int count, int *sectors, int *numListed)
+{
+    CachedIndex *index;
+    int span = IndexSpan(level - 1);
+
+    if (sector < 0 || sector >= NumSectors)
+        return FALSE;
+    index = GetIndex(link, &sector, FALSE, NULL);
+    sectors[(*numListed)++] = sector;
+    for (int i = 0; count > 0; i++, count -= span)
+    {
+        int s = index->node.dataSectors[i];
+        if (level == 1)
+        {
+            if (s < 0 || s >= NumSectors)
+                return FALSE;
+            sectors[(*numListed)++] = s;
+        }
+        else if (!ListIndex(&index->child[i], s, level - 1, min(count, span),
+                            sectors, numListed))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IsInline
+// 	Return TRUE if the file's data is kept in the header (it has some
+//	data, and no data sectors).
+//----------------------------------------------------------------------
+
+bool FileHeader::IsInline()
+{
+    return numSectors == 0 && numBytes > 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadInline/WriteInline
+// 	Copy the data of an inline file to/from "data", which holds the
+//	file's first (and only) sector.  Bytes past the end of the file
+//	read as zero.  WriteInline only changes the header in memory: the
+//	caller writes it back.
+//----------------------------------------------------------------------
+
+void FileHeader::ReadInline(char *data)
+{
+    ASSERT(numSectors == 0 && numBytes <= InlineSize);
+    bcopy((char *)dataSectors, data, numBytes);
+    bzero(&data[numBytes], SectorSize - numBytes);
+}
+
+void FileHeader::WriteInline(char *data)
+{
+    ASSERT(numSectors == 0 && numBytes <= InlineSize);
+    bcopy(data, (char *)dataSectors, numBytes);
+    bzero((char *)dataSectors + numBytes, InlineSize - numBytes);
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk.
+// 	Fetch contents of file header from disk.  Headers are metadata, so
+//	they go through the journal, which may hold a newer copy.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
 
 void FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    InvalidateIndexCache(); // cached blocks belong to the old contents
+    journal->ReadSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk.
+// 	Write the modified contents of the file header back to disk, by
+//	way of the journal (it reaches its sector at the next commit).
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
 
 void FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this);
+    journal->WriteSector(sector, (char *)this);
 }
 
 //----------------------------------------------------------------------
@@ -160,20 +417,183 @@ void FileHeader::WriteBack(int sector)
 
 int FileHeader::ByteToSector(int offset)
 {
-    if (useIndex)
-        return ByteToSectorWithIndex(offset);
-    return (dataSectors[offset / SectorSize]);
+    return SectorOf(offset / SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorOf
+// 	Return the disk sector holding the "which"th data sector of the
+//	file, going through at most IndexLevels (cached) index blocks.
+//----------------------------------------------------------------------
+
+int FileHeader::SectorOf(int which)
+{
+    ASSERT(which >= 0 && which < numSectors);
+    if (which < NumDirect)
+        return dataSectors[which];
+    which -= NumDirect;
+    for (int level = 1; level <= IndexLevels; level++)
+    {
+        if (which < IndexSpan(level))
+        {
+            int slot;
+            CachedIndex *index = WalkIndex(level, which, NULL, &slot);
+            return index->node.dataSectors[slot];
+        }
+        which -= IndexSpan(level);
+    }
+    ASSERT(FALSE); // numSectors never exceeds MaxFileSectors
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WalkIndex
+// 	Follow the level-"level" index tree down to the bottom index block
+//	that maps data sector "which" (counted from the start of that
+//	tree), and store the position within that block in "slot".
+//
+//	If "freeMap" is non-NULL we are growing the file, and "which" is
+//	the first sector not yet mapped: index blocks that don't exist
+//	yet are allocated out of "freeMap" on the way down.
+//----------------------------------------------------------------------
+
+CachedIndex *
+FileHeader::WalkIndex(int level, int which, BitMap *freeMap, int *slot)
+{
+    bool fresh = (freeMap != NULL && which == 0);
+    CachedIndex *index = GetIndex(&indexCache[level - 1], &indirect[level - 1],
+                                  fresh, freeMap);
+
+    for (int span = IndexSpan(level - 1); span > 1; span /= NumIndirect)
+    {
+        int i = which / span;
+        which %= span;
+        fresh = (freeMap != NULL && which == 0);
+        if (fresh)
+            index->dirty = TRUE; // about to point at a new child
+        index = GetIndex(&index->child[i], &index->node.dataSectors[i],
+                         fresh, freeMap);
+    }
+    *slot = which;
+    return index;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GetIndex
+// 	Return the cached copy of the index block whose sector number is
+//	stored in "*sector", and whose cached copy (if any) is "*link".
+//	If "fresh", a brand new empty index block is allocated out of
+//	"freeMap" and recorded in "*sector"; otherwise the block is read
+//	from disk the first time it is needed.
+//
+//	Readers of a file share its header (cf. inodetable.h), so another
+//	reader may have read the same block in while we waited for the
+//	disk; then its copy is the one kept.
+//----------------------------------------------------------------------
+
+CachedIndex *
+FileHeader::GetIndex(CachedIndex **link, int *sector, bool fresh,
+                     BitMap *freeMap)
+{
+    if (*link != NULL && !fresh)
+        return *link;
+
+    CachedIndex *index = new CachedIndex;
+    for (int i = 0; i < NumIndirect; i++)
+        index->child[i] = NULL;
+    if (fresh)
+    {
+        FreeIndex(*link);
+        *sector = freeMap->Find();
+        bzero((char *)&index->node, sizeof(IndexNode));
+        index->dirty = TRUE;
+    }
+    else
+    {
+        synchDisk->ReadSector(*sector, (char *)&index->node);
+        if (*link != NULL)
+        { // beaten to it
+            delete index;
+            return *link;
+        }
+        index->dirty = FALSE;
+    }
+    index->sector = *sector;
+    *link = index;
+    return index;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FlushIndex
+// 	Write every dirty cached index block at or below "index" to disk.
+//----------------------------------------------------------------------
+
+void FileHeader::FlushIndex(CachedIndex *index)
+{
+    if (index == NULL)
+        return;
+    for (int i = 0; i < NumIndirect; i++)
+        FlushIndex(index->child[i]);
+    if (index->dirty)
+    {
+        synchDisk->WriteSector(index->sector, (char *)&index->node);
+        index->dirty = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeIndex
+// 	Delete the cached copy of "index" and everything cached below it.
+//----------------------------------------------------------------------
+
+void FileHeader::FreeIndex(CachedIndex *index)
+{
+    if (index == NULL)
+        return;
+    for (int i = 0; i < NumIndirect; i++)
+        FreeIndex(index->child[i]);
+    delete index;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ByteRangeToSectors
+// 	Translate every sector touched by a byte range of the file into
+//	its disk sector, in file order.  This lets ReadAt/WriteAt look up
+//	a whole request at once, instead of one ByteToSector per sector.
+//
+//	"offset" is the location within the file of the first byte
+//	"length" is the number of bytes in the range (must be > 0)
+//	"sectors" is filled with the disk sector numbers; it must have
+//	   room for one entry per sector in the range
+//
+//	Returns the number of entries filled in.
+//----------------------------------------------------------------------
+
+int FileHeader::ByteRangeToSectors(int offset, int length, int *sectors)
+{
+    int firstSector = offset / SectorSize;
+    int lastSector = (offset + length - 1) / SectorSize;
+    int count = 0;
+
+    ASSERT(length > 0 && lastSector < numSectors);
+    for (int i = firstSector; i <= lastSector; i++)
+        sectors[count++] = SectorOf(i);
+    return count;
 }
 
-int FileHeader::ByteToSectorWithIndex(int offset)
+//----------------------------------------------------------------------
+// FileHeader::InvalidateIndexCache
+// 	Forget every cached index block, because the on-disk copies
+//	(or the header that points at them) have changed.
+//----------------------------------------------------------------------
+
+void FileHeader::InvalidateIndexCache()
 {
-    int whichSector = offset / SectorSize;   //要读取的是第几个扇区
-    int whichNode = whichSector / NumSecond; //要读取第几个二级索引块
-    SecondNode *node = new SecondNode;
-    synchDisk->ReadSector(dataSectors[whichNode], (char *)node); //读取二级索引块
-    int sector = node->dataSectors[whichSector - whichNode * NumSecond];
-    delete node;
-    return sector;
+    for (int i = 0; i < IndexLevels; i++)
+    {
+        FreeIndex(indexCache[i]);
+        indexCache[i] = NULL;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -193,21 +613,36 @@ int FileHeader::FileLength()
 //----------------------------------------------------------------------
 void FileHeader::Print()
 {
-    if (useIndex)
-    {
-        PrintWithIndex();
-        return;
-    }
     int i, j, k;
     char *data = new char[SectorSize];
 
+    if (IsInline())
+    {
+        printf("FileHeader contents.  File size: %d, kept in the header.\n"
+               "File contents:\n", numBytes);
+        ReadInline(data);
+        for (j = 0; j < numBytes; j++)
+            if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
+                printf("%c", data[j]);
+            else
+                printf("\\%x", (unsigned char)data[j]);
+        printf("\n");
+        delete[] data;
+        return;
+    }
     printf("FileHeader contents.  File size: %d.  File blocks:", numBytes);
     for (i = 0; i < numSectors; i++)
-        printf("%d ", dataSectors[i]);
+        printf("%d ", SectorOf(i));
+    printf("\nIndex blocks:");
+    for (i = 0, k = NumDirect; i < IndexLevels && numSectors > k; i++)
+    {
+        printf(" level %d at %d", i + 1, indirect[i]);
+        k += IndexSpan(i + 1);
+    }
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++)
     {
-        synchDisk->ReadSector(dataSectors[i], data);
+        synchDisk->ReadSector(SectorOf(i), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++)
         {
             if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
@@ -220,136 +655,44 @@ void FileHeader::Print()
     delete[] data;
 }
 
-void FileHeader::PrintWithIndex()
-{
-    int i, j, k;
-    char *data = new char[SectorSize];
-
-    printf("FileHeader contents.  File size: %d.\n", numBytes);
-    int numNode = divRoundUp(numSectors, NumSecond); //计算二级节点数
-    for (i = 0; i < numNode; i++)
-    {
-        printf("First file blocks:%d,second file blocks:", dataSectors[i]);
-        SecondNode *node = new SecondNode;
-        synchDisk->ReadSector(dataSectors[i], (char *)node);
-        if (i < numNode - 1)
-            for (j = 0; j < NumSecond; j++)
-                printf("%d ", node->dataSectors[j]);
-        else
-            for (j = 0; j < numSectors - NumSecond * (numNode - 1); j++)
-                printf("%d ", node->dataSectors[j]);
-        delete node;
-    }
-    printf("\nFile contents:\n");
-    for (int l = 0; l < numNode; l++)
-    {
-        k = 0; //记录已打印字符数
-        SecondNode *node = new SecondNode;
-        synchDisk->ReadSector(dataSectors[l], (char *)node);
-        if (l < numNode - 1)
-        { //打印前面的二级节点
-            for (i = 0; i < NumSecond; i++)
-            {
-                synchDisk->ReadSector(node->dataSectors[i], data);
-                for (j = 0; (j < SectorSize); j++, k++)
-                {
-                    if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
-                        printf("%c", data[j]);
-                    else
-                        printf("\\%x", (unsigned char)data[j]);
-                }
-                printf("\n");
-            }
-        }
-        else
-        { //打印最后一个二级节点
-            for (i = 0; i < numSectors - NumSecond * (numNode - 1); i++)
-            {
-                synchDisk->ReadSector(node->dataSectors[i], data);
-                for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++)
-                {
-                    if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
-                        printf("%c", data[j]);
-                    else
-                        printf("\\%x", (unsigned char)data[j]);
-                }
-                printf("\n");
-            }
-        }
-        delete node;
-    }
-
-    delete[] data;
-}
+//----------------------------------------------------------------------
+// FileHeader::addLength
+// 	Grow the file by "addBytes" bytes, allocating any new data sectors
+//	(and index blocks) it needs.  Return FALSE, leaving the file
+//	unchanged, if there is no room.
+//
+//	Neither the header nor the bitmap is written back: the caller
+//	writes the header (cf. FileSystem::ExtendFile), and the file
+//	system the bitmap when it commits.
+//
+//	A file still small enough stays in the header.  One that grows
+//	out of it has its data moved to its first data sector (which is
+//	new, so can be written straight away).
+//
+//	"addBytes" is how many bytes to add to the end of the file
+//	"freeMap" is the bitmap of free disk sectors
+//----------------------------------------------------------------------
 
-bool FileHeader::addLength(int addBytes, int headSector, OpenFile *freeMapFile)
+bool FileHeader::addLength(int addBytes, BitMap *freeMap)
 {
-    //文件增加大小
-    numBytes += addBytes;
-    int oldNumSectors = numSectors;                //原来的扇区数
-    numSectors = divRoundUp(numBytes, SectorSize); //新的扇区数
-    if (numSectors - oldNumSectors == 0)
-    {
-        this->WriteBack(headSector); //写回文件头
-        return true;                 //不需要新增扇区，只改变文件长度
-    }
-    //需要新增扇区
-    BitMap *freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-    if (numSectors <= NumFirst)
-    { //不需要二级索引
-        DEBUG('f',"扩充大小:无二级索引\n");
-        for (int i = oldNumSectors; i < numSectors; i++)
-            dataSectors[i] = freeMap->Find();
-        freeMap->WriteBack(freeMapFile); //写回空位图
-        delete freeMap;
-        this->WriteBack(headSector); //写回文件头
-        return true;
-    }
-    if (numSectors > NumFirst && !useIndex)
-    { //需要建立二级索引
-        DEBUG('f',"扩充大小:使用二级索引\n");
-        SecondNode *snode = new SecondNode;
-        int sec = freeMap->Find();
-        for (int i = 0; i < oldNumSectors; i++)
-            snode->dataSectors[i] = dataSectors[i];
-        dataSectors[0] = sec;
-        synchDisk->WriteSector(sec, (char *)snode);
-        useIndex = true;
-        delete snode;
-    }
-    int oldNumNode = divRoundUp(oldNumSectors, NumSecond); //原来的索引节点数
-    int numNode = divRoundUp(numSectors, NumSecond);       //新的索引节点数
-    int needNode = numNode - oldNumNode;                   //需要新分配的索引节点数
-    if (oldNumSectors % NumSecond != 0)
-    { //如果可能，填充原来的最后一个索引节点剩余部分
-        SecondNode *snode = new SecondNode;
-        synchDisk->ReadSector(dataSectors[oldNumNode - 1], (char *)snode);
-
-        for (int i = oldNumSectors - (oldNumNode - 1) * NumSecond; i < NumSecond && i < numSectors - (oldNumNode - 1) * NumSecond; i++)
+    int newNumSectors = divRoundUp(numBytes + addBytes, SectorSize); //新的扇区数
+    bool wasInline = IsInline();
+    char data[SectorSize];
+
+    if (numSectors == 0 && numBytes + addBytes <= InlineSize)
+        newNumSectors = 0; // still fits in the header
+    if (newNumSectors != numSectors)
+    { //需要新增扇区
+        if (wasInline)
+            ReadInline(data); // about to be overwritten by pointers
+        if (!Extend(freeMap, newNumSectors))
         {
-            DEBUG('f',"扩充大小:填充原来的最后一个索引节点剩余部分\n");
-            snode->dataSectors[i] = freeMap->Find(); //填充第一个索引节点的剩余部分
+            DEBUG('f', "Cannot grow file to %d sectors.\n", newNumSectors);
+            return FALSE;
         }
-        synchDisk->WriteSector(dataSectors[oldNumNode - 1], (char *)snode);
-        delete snode;
-    }
-    for (int i = oldNumNode; i < numNode; i++)
-    {
-        //printf("扩充大小:新建索引节点\n");
-        SecondNode *snode = new SecondNode;
-        int sec = freeMap->Find();
-        dataSectors[i] = sec; //为索引节点寻找新扇区
-        if (i < numNode - 1)
-            for (int j = 0; j < NumSecond; j++)
-                snode->dataSectors[j] = freeMap->Find();
-        else
-            for (int j = 0; j < numSectors - NumSecond * (numNode - 1); j++)
-                snode->dataSectors[j] = freeMap->Find();
-        synchDisk->WriteSector(sec, (char *)snode); //写回索引节点信息
+        if (wasInline)
+            synchDisk->WriteSector(dataSectors[0], data);
     }
-    this->WriteBack(headSector);     //写回文件头
-    freeMap->WriteBack(freeMapFile); //写回空位图
-    delete freeMap;
-    return true;
-}
\ No newline at end of file
+    numBytes += addBytes;
+    return TRUE;
+}
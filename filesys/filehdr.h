@@ -17,35 +17,59 @@
 #include "disk.h"
 #include "bitmap.h"
 
-//#define NumDirect ((SectorSize - 2 * sizeof(int)-sizeof(FileNode*)) / sizeof(int))
-#define MaxFileSize (NumFirst * NumSecond * SectorSize)
-//#define NumNode (SectorSize-sizeof(FileNode*))/sizeof(int)
-const int NumFirst=(SectorSize - 2 * sizeof(int) - sizeof(bool)) / sizeof(int);
-const int NumSecond=SectorSize / sizeof(int);
+// The file header points at data sectors through a Unix-style multi-level
+// index: NumDirect direct pointers, then one single, one double and one
+// triple indirect pointer (indirect[0..IndexLevels-1]).  Each index block
+// is one sector full of sector numbers.
+#define IndexLevels 3 // single, double and triple indirect
+const int NumIndirect = SectorSize / sizeof(int); // sector numbers per index block
+const int NumDirect = (SectorSize - (2 + IndexLevels) * sizeof(int)) / sizeof(int);
+#define MaxFileSectors (NumDirect + NumIndirect + NumIndirect * NumIndirect + \
+                        NumIndirect * NumIndirect * NumIndirect)
+#define MaxFileSize (MaxFileSectors * SectorSize)
+
+// A file of at most InlineSize bytes needs no sector pointers, so it
+// keeps its data in their place, in the header itself: no data sector,
+// and reading the header reads the data.  A file grows out of this
+// (cf. addLength) into ordinary data sectors.
+#define InlineSize ((NumDirect + IndexLevels) * (int)sizeof(int))
 
 // The following class defines the Nachos "file header" (in UNIX terms,
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks.
+// The first NumDirect data sectors are listed in the header itself; the
+// rest are reached through up to IndexLevels levels of index blocks.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The constructor only sets up the in-memory cache of index blocks;
+// the file header itself is initialized by allocating blocks for the
+// file (if it is a new file), or by reading it from disk.
 
-struct SecondNode
-{ //间接索引点
-  int dataSectors[NumSecond];
+struct IndexNode
+{ //索引块在磁盘上的格式
+  int dataSectors[NumIndirect];
+};
+
+// In-memory copy of an index block, linked to the copies of the index
+// blocks below it that have been read so far.
+struct CachedIndex
+{
+  int sector;                       // Where the block lives on disk
+  bool dirty;                       // Modified since read/allocated?
+  IndexNode node;                   // Contents of the block
+  CachedIndex *child[NumIndirect];  // Cached blocks one level down
+                                    // (unused in the bottom level)
 };
 
 class FileHeader
 {
 public:
+  FileHeader();  // Start with an empty index block cache
+  ~FileHeader(); // Release any cached index blocks
+
   bool Allocate(BitMap *bitMap, int fileSize); // Initialize a file header,
                                                //  including allocating space
                                                //  on disk for the file data
@@ -60,28 +84,56 @@ public:
                                 // to the disk sector containing
                                 // the byte
 
+  int ByteRangeToSectors(int offset, int length, int *sectors);
+                                // Fill "sectors" with the disk sector of
+                                // every sector touched by the byte range,
+                                // return how many were filled in
+
   int FileLength(); // Return the length of the file
                     // in bytes
 
   void Print(); // Print the contents of the file.
 
   //自定义函数
-  bool addLength(int addBytes, int sector, OpenFile *freeMapFile); //增加的长度，文件头所在的扇区
-
-  bool AllocateWithIndex(BitMap *freeMap, int fileSize);
-
-  void DeallocateWithIndex(BitMap *freeMap);
-
-  int ByteToSectorWithIndex(int offset);
+  bool addLength(int addBytes, BitMap *freeMap); //增加的长度，不写回文件头
+  static int SectorsFor(int fileSize); // Sectors (data and index blocks)
+                                       // a file of "fileSize" bytes uses
+  int AllSectors(int *sectors);        // List them, for a checker; -1
+                                       // if the header is damaged
 
-  void PrintWithIndex();
+  bool IsInline();                     // Is the data in the header?
+  void ReadInline(char *data);         // Copy it out, as a sector
+  void WriteInline(char *data);        // Copy it in, from a sector
 
 private:
-  int numBytes;              // Number of bytes in the file
-  int numSectors;            // Number of data sectors in the file
-  int dataSectors[NumFirst]; // Disk sector numbers for each data
-                             // block in the file
-  bool useIndex;
+  int numBytes;                 // Number of bytes in the file
+  int numSectors;               // Number of data sectors in the file
+  int dataSectors[NumDirect];   // Disk sector numbers for the first
+                                // NumDirect data blocks in the file
+  int indirect[IndexLevels];    // Root index block of each level
+                                // (an inline file's data is kept in
+                                // dataSectors and indirect instead)
+
+  // Everything above is the on-disk image of the header (exactly one
+  // sector); FetchFrom/WriteBack only transfer that much.  The fields
+  // below live in memory only.
+  CachedIndex *indexCache[IndexLevels]; // Index blocks read so far,
+                                        // NULL if not yet read
+
+  bool Extend(BitMap *freeMap, int newNumSectors); // Map data sectors up
+                                                   // to "newNumSectors"
+  int SectorOf(int which);                         // Disk sector of the
+                                                   // "which"th data sector
+  CachedIndex *WalkIndex(int level, int which, BitMap *freeMap, int *slot);
+  CachedIndex *GetIndex(CachedIndex **link, int *sector, bool fresh,
+                        BitMap *freeMap);
+  void DeallocateIndex(BitMap *freeMap, CachedIndex **link, int sector,
+                       int level, int count);
+  bool ListIndex(CachedIndex **link, int sector, int level, int count,
+                 int *sectors, int *numListed);
+  void FlushIndex(CachedIndex *index);     // Write back dirty index blocks
+  void FreeIndex(CachedIndex *index);      // Drop cached index blocks
+  void InvalidateIndexCache();             // Drop all cached index blocks
 };
 
 #endif // FILEHDR_H
@@ -19,25 +19,27 @@
 //	on bootup.
 //
 //	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	kept "open" continuously while Nachos is running.  Their contents
+//	are also kept in memory the whole time, so looking up a name or
+//	allocating a sector costs no disk I/O.
 //
 //	For those operations (such as Create, Remove) that modify the
-//	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
-//
-// 	Our implementation at this point has the following restrictions:
-//
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	directory and/or bitmap, only the in-memory copies are changed
+//	(and put back the way they were if the operation fails).  Changed
+//	metadata reaches the disk through the journal (cf. journal.h):
+//	every JournalGroupSize operations, or when Sync is called, the
+//	changed sectors of the bitmap and directory are handed to the
+//	journal together with the file headers written since the last
+//	commit, and the whole group is committed atomically.
+//
+//	The space of a removed file is only given back when the removal
+//	is committed, so that nothing committed on disk is ever
+//	overwritten by data belonging to an uncommitted operation.
+//
+// 	Our implementation at this point has the following restriction:
+//
+//	   if Nachos exits without calling Sync, the operations since
+//	    the last commit are lost (but the disk stays consistent)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -50,6 +52,9 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "list.h"
+#include "synch.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known
@@ -57,9 +62,10 @@
 #define FreeMapSector 0   //空位图扇区地址
 #define DirectorySector 1 //目录扇区地址
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and root directory.  The bitmap file
+// never changes size; directory files grow as entries are added, so the
+// root directory size is only a starting point (other directories start
+// out empty).
 #define FreeMapFileSize (NumSectors / BitsInByte)                  //空位图大小=扇区数/每字节比特数
 #define NumDirEntries 10                                           //目录条数
 #define DirectoryFileSize (sizeof(DirectoryEntry) * NumDirEntries) //目录文件大小=每个目录大小*目录数
@@ -68,11 +74,12 @@
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).
+//	an empty directory, an empty journal, and a bitmap of free sectors
+//	(with almost but not all of the sectors marked as free).
 //
-//	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format = FALSE, we replay the journal if the last run stopped
+//	in the middle of a commit, then open the files representing the
+//	bitmap and the root directory and read both into memory.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -80,19 +87,30 @@
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+    freeMap = new BitMap(NumSectors);
+    nameCache = new NameCache;
+    for (int i = 0; i < DirCacheSize; i++)
+        dirCache[i] = NULL;
+    numDeferred = 0;
+    reserved = 0;
+    numOps = 0;
+    syncing = FALSE;
+    lock = new Lock("file system");
+    lockDepth = 0;
     if (format)
     {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
+        journal->Format();
 
-        // First, allocate space for FileHeaders for the directory and bitmap
-        // (make sure no one else grabs these!)
+        // First, allocate space for FileHeaders for the directory and bitmap,
+        // and for the journal (make sure no one else grabs these!)
         freeMap->Mark(FreeMapSector);
         freeMap->Mark(DirectorySector);
+        for (int i = 0; i < JournalSectors; i++)
+            freeMap->Mark(JournalSector + i);
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
@@ -103,7 +121,8 @@ FileSystem::FileSystem(bool format)
         // Flush the bitmap and directory FileHeaders back to disk
         // We need to do this before we can "Open" the file, since open
         // reads the file header off of disk (and currently the disk has garbage
-        // on it!).
+        // on it!).  The journal holds on to them until Sync below, and
+        // hands them to the OpenFile constructor in the meantime.
 
         DEBUG('f', "Writing headers back to disk.\n");
         mapHdr->WriteBack(FreeMapSector);
@@ -114,38 +133,59 @@ FileSystem::FileSystem(bool format)
         // while Nachos is running.
 
         freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile->SetJournaled();
+        root = LoadDirectory(DirectorySector, TRUE);
+        ASSERT(root->dir->NumEntries() == NumDirEntries);
 
         // Once we have the files "open", we can write the initial version
         // of each file back to disk.  The directory at this point is completely
-        // empty; but the bitmap has been changed to reflect the fact that
+        // empty (but every entry of it is new, so it is all written);
+        // the bitmap has been changed to reflect the fact that
         // sectors on the disk have been allocated for the file headers and
         // to hold the file data for the directory and bitmap.
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
-        freeMap->WriteBack(freeMapFile); // flush changes to disk
-        directory->WriteBack(directoryFile);
+        Sync();
 
         if (DebugIsEnabled('f'))
         {
             freeMap->Print();
-            directory->Print();
-
-            delete freeMap;
-            delete directory;
-            delete mapHdr;
-            delete dirHdr;
+            root->dir->Print();
         }
+        delete mapHdr;
+        delete dirHdr;
     }
     else
     {
-        // if we are not formatting the disk, just open the files representing
-        // the bitmap and directory; these are left open while Nachos is running
+        // if we are not formatting the disk, finish any interrupted
+        // commit, then open the files representing the bitmap and
+        // directory; these are left open while Nachos is running
+        journal->Recover();
         freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile->SetJournaled();
+        freeMap->FetchFrom(freeMapFile);
+        root = LoadDirectory(DirectorySector);
     }
 }
 
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	De-allocate the in-memory copies of the bitmap and directories.
+//	This does no disk I/O (Nachos may be halting from inside the
+//	idle loop), so anything not yet committed by Sync is lost.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    for (int i = 0; i < DirCacheSize; i++)
+        while (dirCache[i] != NULL)
+            DropDirectory(dirCache[i]->sector);
+    delete freeMapFile;
+    delete freeMap;
+    delete nameCache;
+    delete lock;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
@@ -153,70 +193,83 @@ FileSystem::FileSystem(bool format)
 //	to give Create the initial size of the file.
 //
 //	The steps to create a file are:
+//	  Find the directory that is to hold it
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
 //	  Add the name to the directory
-//	  Store the new file header on disk
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  Store the new file header on disk (through the journal)
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
+//		a directory on the path does not exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+//	If there is no room but removed files are waiting for their space
+//	to be released, we commit (releasing it) and try once more.
+//
+//	The directory file only grows when the next commit writes it, so
+//	the sectors it will need for the new name are set aside now: the
+//	commit must not find the disk full.
+//
+//	The name is only added once the header is written, so that a
+//	lookup without the lock never finds a header that isn't there.
 //
-//	"name" -- name of file to be created
+//	"name" -- path name of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
 
 bool FileSystem::Create(char *name, int initialSize)
 {
-    Directory *directory;
-    BitMap *freeMap;
+    char fileName[FileNameMaxLen + 1];
+    OpenDirectory *parent;
     FileHeader *hdr;
-    int sector;
-    bool success;
+    int sector, grow = 0;
+    bool success = FALSE;
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    Enter();
+    parent = FindParent(name, fileName);
+    if (parent == NULL || parent->dir->Find(fileName) != -1)
+    {
+        Leave();
+        return FALSE; // no such directory, or file is already there
+    }
 
-    if (directory->Find(name) != -1)
-        success = FALSE; // file is already in directory
+    grow = DirectoryGrowth(parent);
+    if (HasRoom(1 + FileHeader::SectorsFor(initialSize) + grow))
+        sector = freeMap->Find(); // find a sector to hold the file header
     else
+        sector = -1;
+    if (sector != -1)
     {
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find(); // find a sector to hold the file header
-        if (sector == -1)
-            success = FALSE; // no free block for file header
-        else if (!directory->Add(name, sector))
-            success = FALSE; // no space in directory
-        else
+        hdr = new FileHeader;
+        if (hdr->Allocate(freeMap, initialSize))
         {
-            hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, initialSize))
-                success = FALSE; // no space on disk for data
-            else
-            {
-                success = TRUE;
-                // everthing worked, flush all changes back to disk
-                hdr->WriteBack(sector);
-                directory->WriteBack(directoryFile);
-                freeMap->WriteBack(freeMapFile);
-            }
-            delete hdr;
+            success = TRUE;
+            hdr->WriteBack(sector);
+            parent->dir->Add(fileName, sector);
+            reserved += grow; // for the directory, until it is written
+            parent->reserved += grow;
+            nameCache->Invalidate(name); // may be cached as missing
         }
-        delete freeMap;
+        else
+            freeMap->Clear(sector); // no space on disk for data
+        delete hdr;
+    }
+
+    if (!success && numDeferred > 0)
+    { // space of removed files may be enough
+        Sync();
+        success = Create(name, initialSize);
     }
-    delete directory;
+    else if (success)
+        EndOp();
+    Leave();
     return success;
 }
 
@@ -224,97 +277,699 @@ bool FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.
 //	To open a file:
-//	  Find the location of the file's header, using the directory
+//	  Find the location of the file's header, by looking up each
+//	    name on the path in turn -- unless the name cache already
+//	    knows where (or that it is nowhere)
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	Directories cannot be opened this way.
+//
+//	The lookup takes no lock (cf. filesys.h): nothing from its start
+//	until the OpenFile has a reference to the header can block, so
+//	the file can't be removed in between.  Only if a directory on the
+//	path must be read in do we take the lock, and start again.
+//
+//	"name" -- the path name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 {
-    Directory *directory = new Directory(NumDirEntries);
+    char fileName[FileNameMaxLen + 1];
+    OpenDirectory *parent;
     OpenFile *openFile = NULL;
+    bool locked = FALSE, uncached;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector >= 0)
+    while (!nameCache->Lookup(name, &sector))
     {
-        openFile = new OpenFile(sector); // name was found in directory
-        openFile->setFreeMap(freeMapFile);
+        uncached = FALSE;
+        parent = FindParent(name, fileName, locked ? NULL : &uncached);
+        if (uncached)
+        { // a directory must be read in: look again, with the lock
+            Enter();
+            locked = TRUE;
+            continue;
+        }
+        if (parent == NULL || parent->dir->IsDir(fileName))
+            sector = -1;
+        else
+            sector = parent->dir->Find(fileName);
+        nameCache->Enter(name, sector);
+        break;
     }
+    if (sector >= 0)
+        openFile = new OpenFile(sector); // name was found in directory
+    if (locked)
+        Leave();
 
-    delete directory;
     return openFile; // return NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from its directory
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//
+//	Only the first step happens right away; the space is given back
+//	by the commit that records the removal (cf. Sync) -- or, if the
+//	file is still open, by the first commit after it is last closed.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system (or is a directory -- cf. Rmdir).
 //
-//	"name" -- the text name of the file to be removed
+//	"name" -- the path name of the file to be removed
 //----------------------------------------------------------------------
 
 bool FileSystem::Remove(char *name)
 {
-    Directory *directory;
-    BitMap *freeMap;
-    FileHeader *fileHdr;
+    char fileName[FileNameMaxLen + 1];
+    OpenDirectory *parent;
     int sector;
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
+    Enter();
+    parent = FindParent(name, fileName);
+    sector = -1;
+    if (parent != NULL && !parent->dir->IsDir(fileName))
+        sector = parent->dir->Find(fileName);
     if (sector == -1)
     {
-        delete directory;
+        Leave();
         return FALSE; // file not found
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    parent->dir->Remove(fileName);
+    nameCache->Invalidate(name);
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+    if (!inodeTable->Unlink(sector))
+        FreeLater(sector); // else freed when it is last closed
+    EndOp();
+    Leave();
+    return TRUE;
+}
 
-    fileHdr->Deallocate(freeMap); // remove data blocks
-    freeMap->Clear(sector);       // remove header block
-    directory->Remove(name);
+//----------------------------------------------------------------------
+// FileSystem::Mkdir
+// 	Create an empty directory (similar to UNIX mkdir).  A directory
+//	is a file holding directory entries; it starts out empty and
+//	grows as names are added to it.
+//
+//	Return FALSE if the parent directory does not exist, the name is
+//	already taken, or there is no free sector for the header (or for
+//	the parent directory to grow, cf. Create).
+//
+//	"name" -- path name of the directory to be created
+//----------------------------------------------------------------------
 
-    freeMap->WriteBack(freeMapFile);     // flush to disk
-    directory->WriteBack(directoryFile); // flush to disk
-    delete fileHdr;
-    delete directory;
-    delete freeMap;
+bool FileSystem::Mkdir(char *name)
+{
+    char dirName[FileNameMaxLen + 1];
+    OpenDirectory *parent;
+    FileHeader *hdr;
+    int sector, grow;
+    bool success;
+
+    DEBUG('f', "Creating directory %s\n", name);
+
+    Enter();
+    parent = FindParent(name, dirName);
+    if (parent == NULL || parent->dir->Find(dirName) != -1)
+    {
+        Leave();
+        return FALSE; // no such directory, or name is already there
+    }
+
+    grow = DirectoryGrowth(parent);
+    sector = HasRoom(1 + grow) ? freeMap->Find() : -1; // a sector for the header
+    if (sector == -1)
+    {
+        success = FALSE;
+        if (numDeferred > 0)
+        {
+            Sync(); // release the space of removed files, try again
+            success = Mkdir(name);
+        }
+        Leave();
+        return success;
+    }
+    hdr = new FileHeader;
+    ASSERT(hdr->Allocate(freeMap, 0));
+    hdr->WriteBack(sector);
+    delete hdr;
+    (void) LoadDirectory(sector, TRUE); // before anyone can find it
+    parent->dir->Add(dirName, sector, TRUE);
+    reserved += grow;
+    parent->reserved += grow;
+    nameCache->Invalidate(name);
+    EndOp();
+    Leave();
     return TRUE;
 }
+
+//----------------------------------------------------------------------
+// FileSystem::Rmdir
+// 	Delete a directory (similar to UNIX rmdir).  Like Remove, the
+//	space is given back by the next commit.
+//
+//	Return FALSE if "name" is not a directory, or is not empty.
+//
+//	"name" -- path name of the directory to be removed
+//----------------------------------------------------------------------
+
+bool FileSystem::Rmdir(char *name)
+{
+    char dirName[FileNameMaxLen + 1];
+    OpenDirectory *parent;
+    int sector;
+
+    Enter();
+    parent = FindParent(name, dirName);
+    if (parent == NULL || !parent->dir->IsDir(dirName) ||
+        !LoadDirectory(parent->dir->Find(dirName))->dir->IsEmpty())
+    {
+        Leave();
+        return FALSE;
+    }
+    sector = parent->dir->Find(dirName);
+
+    parent->dir->Remove(dirName);
+    nameCache->Invalidate(name);
+    DropDirectory(sector); // only once nobody can find it
+    if (!inodeTable->Unlink(sector))
+        FreeLater(sector);
+    EndOp();
+    Leave();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ExtendFile
+// 	Grow an open file by "addBytes" bytes, taking any new sectors out
+//	of the in-memory bitmap.  Like Create, if the disk is full but
+//	removed files are waiting for their space, commit and retry.
+//
+//	The caller calls EndOp once it has written the data.  Writing the
+//	data may block, and another thread may commit meanwhile; a caller
+//	that writes the data straight to disk (not through the journal)
+//	passes "writeBack" FALSE, and calls WriteHeader once the data is
+//	out, so that no commit can take the header before its data.
+//	Directory files grow this way too, while Sync writes them back;
+//	that growth is part of the commit in progress, not a new operation.
+//
+//	"hdr" -- the file's header, as kept by its OpenFile
+//	"sector" -- where that header lives on disk
+//	"addBytes" -- how many bytes to add to the end of the file
+//	"fromReserve" -- how many sectors, set aside by Reserve for this
+//		growth, to give back first (in the same step, so that no
+//		other operation can take them meanwhile)
+//	"writeBack" -- write the grown header back now
+//----------------------------------------------------------------------
+
+bool FileSystem::ExtendFile(FileHeader *hdr, int sector, int addBytes,
+                            int fromReserve, bool writeBack)
+{
+    int length = hdr->FileLength();
+    int needed = FileHeader::SectorsFor(length + addBytes) -
+                 FileHeader::SectorsFor(length);
+    bool success = TRUE;
+
+    Enter();
+    Unreserve(fromReserve);
+    if (!HasRoom(needed) || !hdr->addLength(addBytes, freeMap))
+    {
+        if (numDeferred == 0 || syncing)
+            success = FALSE; // no room on disk
+        else
+        {
+            Sync();
+            success = HasRoom(needed) && hdr->addLength(addBytes, freeMap);
+        }
+    }
+    if (success && writeBack)
+        hdr->WriteBack(sector);
+    Leave();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteHeader
+// 	Write back the header of an open file, whose header is at "sector",
+//	after its data (kept in the header) was changed, or after it was
+//	grown without being written (cf. ExtendFile).  The caller calls
+//	EndOp.
+//----------------------------------------------------------------------
+
+void FileSystem::WriteHeader(FileHeader *hdr, int sector)
+{
+    Enter();
+    hdr->WriteBack(sector);
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Reserve/Unreserve
+// 	Set aside "numSectors" free sectors, so that data already accepted
+//	by a write can be given sectors later (cf. inodetable.h) without
+//	any chance of the disk having filled up meanwhile; or give back
+//	sectors set aside before.  Nothing is allocated: the sectors are
+//	only counted, and no other allocation may dip into that count.
+//
+//	Reserve returns FALSE if there isn't that much room, even after
+//	committing to release the space of removed files.
+//----------------------------------------------------------------------
+
+bool FileSystem::Reserve(int numSectors)
+{
+    bool success = TRUE;
+
+    Enter();
+    if (!HasRoom(numSectors))
+    {
+        if (numDeferred == 0 || syncing)
+            success = FALSE;
+        else
+        {
+            Sync();
+            success = HasRoom(numSectors);
+        }
+    }
+    if (success)
+        reserved += numSectors;
+    Leave();
+    return success;
+}
+
+void FileSystem::Unreserve(int numSectors)
+{
+    Enter();
+    reserved -= numSectors;
+    ASSERT(reserved >= 0);
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::HasRoom
+// 	Return TRUE if "numSectors" sectors can be allocated without
+//	touching the ones set aside by Reserve.
+//----------------------------------------------------------------------
+
+bool FileSystem::HasRoom(int numSectors)
+{
+    return freeMap->NumClear() - reserved >= numSectors;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DirectoryGrowth
+// 	Return how many more sectors must be set aside for directory "d",
+//	so that the next commit can grow its file to hold one more name.
+//----------------------------------------------------------------------
+
+int FileSystem::DirectoryGrowth(OpenDirectory *d)
+{
+    int needed = FileHeader::SectorsFor(d->dir->SizeAfterAdd()) -
+                 FileHeader::SectorsFor(d->file->Length());
+
+    return max(needed - d->reserved, 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Commit every change made since the last commit:
+//	    allocate and write the data delayed in open files
+//	    hand the changed parts of the directories and the bitmap to
+//	      the journal, which already holds the changed file headers
+//	    commit the journal
+//	    release the space of the files removed since then, and
+//	      commit the bitmap again
+//
+//	Directories are written before the bitmap, since adding entries
+//	may grow their files, out of the sectors set aside for them by
+//	Create and Mkdir.  The space of removed files is released
+//	only once their removal is on disk, so that no commit has a
+//	bitmap giving away sectors that a committed file still uses.
+//
+//	If the journal might not take the next file or directory, what
+//	is there so far is committed first (cf. MakeRoom): each file and
+//	each directory is written whole, so every commit is consistent.
+//----------------------------------------------------------------------
+
+void FileSystem::Sync()
+{
+    FileHeader *fileHdr = new FileHeader;
+
+    Enter();
+    syncing = TRUE;
+    inodeTable->Flush();
+    for (int i = 0; i < DirCacheSize; i++)
+        for (OpenDirectory *d = dirCache[i]; d != NULL; d = d->next)
+        {
+            MakeRoom(d->dir->DirtySectors() + 1); // and a grown header
+            reserved -= d->reserved; // for WriteBack to take
+            d->reserved = 0;
+            if (!d->dir->WriteBack(d->file))
+                printf("Directory %d could not grow; retrying at the next commit.\n",
+                       d->sector);
+        }
+    freeMap->WriteBack(freeMapFile);
+    journal->Commit();
+
+    for (int i = 0; i < numDeferred; i++)
+    {
+        fileHdr->FetchFrom(deferredFree[i]);
+        fileHdr->Deallocate(freeMap); // remove data blocks
+        freeMap->Clear(deferredFree[i]); // remove header block
+        journal->Forget(deferredFree[i]); // never copy the old header home
+    }
+    delete fileHdr;
+    if (numDeferred > 0)
+    {
+        numDeferred = 0;
+        freeMap->WriteBack(freeMapFile);
+        journal->Commit();
+    }
+    numOps = 0;
+    syncing = FALSE;
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MakeRoom
+// 	Make sure the journal can take "numSectors" more sectors, and the
+//	whole bitmap besides, by committing now if it might not.  Called
+//	only between steps that leave the file system consistent, so the
+//	commit is too: the bitmap goes with it, and so does every header
+//	written (the space of removed files isn't released until their
+//	removal is committed, cf. Sync).
+//----------------------------------------------------------------------
+
+void FileSystem::MakeRoom(int numSectors)
+{
+    Enter();
+    ASSERT(numSectors + FreeMapSectors <= JournalCapacity);
+    if (journal->Room() < numSectors + FreeMapSectors)
+    {
+        DEBUG('f', "Journal nearly full, committing part of the group.\n");
+        freeMap->WriteBack(freeMapFile);
+        journal->Commit();
+    }
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FreeLater
+// 	Give back the header at "sector" and the file's data sectors at
+//	the next commit.  Until then the space can't be reused, since the
+//	last commit still has the file.
+//----------------------------------------------------------------------
+
+void FileSystem::FreeLater(int sector)
+{
+    Enter();
+    if (numDeferred == JournalGroupSize)
+        Sync(); // commit now, there is no more room to remember it
+    deferredFree[numDeferred++] = sector;
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::EndOp
+// 	Called at the end of every operation that changed the file system.
+//	Commit once a full group of operations has built up, or before
+//	the journal gets too full to take the bitmap and directory too.
+//	What Sync itself does (growing directory files, writing delayed
+//	data) is part of the commit in progress, not a new operation.
+//----------------------------------------------------------------------
+
+void FileSystem::EndOp()
+{
+    Enter();
+    if (!syncing && (++numOps >= JournalGroupSize ||
+                     journal->NumPending() >= JournalMetaCapacity / 2))
+        Sync();
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Enter/Leave
+// 	Take and let go of the file system lock.  Operations call each
+//	other (anything may commit, and a commit writes open files), so a
+//	thread holding the lock may take it again; it is only let go of
+//	when every Enter has had its Leave.
+//----------------------------------------------------------------------
+
+void FileSystem::Enter()
+{
+    if (lock->isHeldByCurrentThread())
+    {
+        lockDepth++;
+        return;
+    }
+    lock->Acquire();
+    lockDepth = 1;
+}
+
+void FileSystem::Leave()
+{
+    ASSERT(lock->isHeldByCurrentThread());
+    if (--lockDepth == 0)
+        lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LoadDirectory
+// 	Return the directory whose header is at "sector", opening its
+//	file and reading it into memory the first time it is asked for.
+//
+//	"fresh" -- the directory was just created: don't read the file,
+//		start with every entry free (and to be written back)
+//----------------------------------------------------------------------
+
+OpenDirectory *
+FileSystem::LoadDirectory(int sector, bool fresh)
+{
+    OpenDirectory **chain = &dirCache[sector % DirCacheSize];
+    OpenDirectory *d = CachedDirectory(sector);
+
+    if (d != NULL)
+        return d;
+
+    DEBUG('f', "Reading in directory at sector %d\n", sector);
+    d = new OpenDirectory;
+    d->sector = sector;
+    d->reserved = 0;
+    d->file = new OpenFile(sector);
+    d->file->SetJournaled();
+    if (fresh)
+        d->dir = new Directory(d->file->Length() / sizeof(DirectoryEntry));
+    else
+    {
+        d->dir = new Directory(0);
+        d->dir->FetchFrom(d->file);
+    }
+    d->next = *chain;
+    *chain = d; // only now that it is all there
+    return d;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CachedDirectory
+// 	Return the directory whose header is at "sector" if it has been
+//	read into memory, or NULL.  Never blocks.
+//----------------------------------------------------------------------
+
+OpenDirectory *
+FileSystem::CachedDirectory(int sector)
+{
+    OpenDirectory *d;
+
+    for (d = dirCache[sector % DirCacheSize]; d != NULL; d = d->next)
+        if (d->sector == sector)
+            return d;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DropDirectory
+// 	Close the directory whose header is at "sector" and forget its
+//	in-memory copy; it is being removed.
+//----------------------------------------------------------------------
+
+void FileSystem::DropDirectory(int sector)
+{
+    OpenDirectory **link = &dirCache[sector % DirCacheSize];
+    OpenDirectory *d;
+
+    while (*link != NULL && (*link)->sector != sector)
+        link = &(*link)->next;
+    if (*link == NULL)
+        return; // never read in
+    d = *link;
+    *link = d->next;
+    reserved -= d->reserved; // its growth is not needed any more
+    delete d->file;
+    delete d->dir;
+    delete d;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Walk "path" from the root directory, and return the directory
+//	that should hold its last name, which is copied into "name".
+//	Empty names (repeated '/') are skipped.
+//
+//	Return NULL if a directory on the way does not exist, or a name
+//	is longer than FileNameMaxLen, or the path has no names at all.
+//
+//	With "uncached", the walk never blocks, so it needs no lock: it
+//	only goes through directories already in memory, and if it comes
+//	to one that isn't, sets "*uncached" and returns NULL.
+//----------------------------------------------------------------------
+
+OpenDirectory *
+FileSystem::FindParent(char *path, char *name, bool *uncached)
+{
+    OpenDirectory *d = root;
+    char *end;
+    int len;
+
+    for (;;)
+    {
+        while (*path == '/')
+            path++;
+        for (end = path; *end != '\0' && *end != '/'; end++)
+            ;
+        len = end - path;
+        if (len == 0 || len > FileNameMaxLen)
+            return NULL;
+        strncpy(name, path, len);
+        name[len] = '\0';
+
+        while (*end == '/')
+            end++;
+        if (*end == '\0')
+            return d; // "name" is the last one
+        if (!d->dir->IsDir(name))
+            return NULL;
+        if (uncached == NULL)
+            d = LoadDirectory(d->dir->Find(name));
+        else if ((d = CachedDirectory(d->dir->Find(name))) == NULL)
+        {
+            *uncached = TRUE;
+            return NULL;
+        }
+        path = end;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindDirectory
+// 	Return the directory "path" names, read in if need be, or NULL
+//	if it isn't a directory.  A path with no names ("/") is the root.
+//----------------------------------------------------------------------
+
+OpenDirectory *
+FileSystem::FindDirectory(char *path)
+{
+    char name[FileNameMaxLen + 1];
+    OpenDirectory *parent;
+    char *p;
+
+    for (p = path; *p == '/'; p++)
+        ;
+    if (*p == '\0')
+        return root;
+    parent = FindParent(path, name);
+    if (parent == NULL || !parent->dir->IsDir(name))
+        return NULL;
+    return LoadDirectory(parent->dir->Find(name));
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
-// 	List all the files in the file system directory.
+// 	List all the files in the file system, one directory after
+//	another, indenting the contents of each subdirectory.
 //----------------------------------------------------------------------
 
 void FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Enter();
+    ListDirectory(root, 0);
+    Leave();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ListDirectory
+// 	List the names in directory "d", and below each subdirectory its
+//	own contents, indented by "depth" levels.
+//----------------------------------------------------------------------
+
+void FileSystem::ListDirectory(OpenDirectory *d, int depth)
+{
+    for (int i = 0; i < d->dir->NumEntries(); i++)
+    {
+        DirectoryEntry *entry = d->dir->Entry(i);
+
+        if (!entry->inUse)
+            continue;
+        printf("%*s%s%s\n", 2 * depth, "", entry->name, entry->isDir ? "/" : "");
+        if (entry->isDir)
+            ListDirectory(LoadDirectory(entry->sector), depth + 1);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::IsDirectory
+// 	Return TRUE if "path" names a directory ("/" is the root).
+//----------------------------------------------------------------------
+
+bool FileSystem::IsDirectory(char *path)
+{
+    bool isDir;
 
-    directory->FetchFrom(directoryFile);
-    directory->List();
-    delete directory;
+    Enter();
+    isDir = (FindDirectory(path) != NULL);
+    Leave();
+    return isDir;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReadDir
+// 	Step through the names in the directory "path" (like UNIX
+//	readdir): return the first name in use at or after entry "*index"
+//	of the directory, and move "*index" past it.  Start with "*index"
+//	at 0.  Return NULL when there are no more names, or if "path" is
+//	not a directory.
+//
+//	The entry returned is the directory's own, and is only good until
+//	the directory is next changed.
+//----------------------------------------------------------------------
+
+DirectoryEntry *
+FileSystem::ReadDir(char *path, int *index)
+{
+    OpenDirectory *d;
+    DirectoryEntry *entry = NULL;
+
+    Enter();
+    d = FindDirectory(path);
+    while (d != NULL && *index < d->dir->NumEntries())
+    {
+        entry = d->dir->Entry((*index)++);
+        if (entry->inUse)
+            break;
+        entry = NULL;
+    }
+    Leave();
+    return entry;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Print
 // 	Print everything about the file system:
 //	  the contents of the bitmap
-//	  the contents of the directory
+//	  the contents of the root directory
 //	  for each file in the directory,
 //	      the contents of the file header
 //	      the data in the file
@@ -324,9 +979,8 @@ void FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
+    Enter();
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
@@ -335,14 +989,198 @@ void FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
-
-    directory->FetchFrom(directoryFile);
-    directory->Print();
+    root->dir->Print();
+    Leave();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
+}
+
+// A name the checker has found in a directory, and has yet to look at.
+struct CheckEntry {
+    OpenDirectory *parent;		// The directory holding the name
+    char name[FileNameMaxLen + 1];	// The name
+    int sector;				// Where its file header is
+    bool isDir;				// Is it a directory?
+};
+
+//----------------------------------------------------------------------
+// QueueEntries
+// 	Add every name in directory "d" to "list", sorted by the sector
+//	of its file header.
+//----------------------------------------------------------------------
+
+static void
+QueueEntries(OpenDirectory *d, List *list)
+{
+    for (int i = 0; i < d->dir->NumEntries(); i++)
+    {
+        DirectoryEntry *entry = d->dir->Entry(i);
+        CheckEntry *e;
+
+        if (!entry->inUse)
+            continue;
+        e = new CheckEntry;
+        e->parent = d;
+        strcpy(e->name, entry->name);
+        e->sector = entry->sector;
+        e->isDir = entry->isDir;
+        list->SortedInsert((void *)e, e->sector);
+    }
+}
+
+//----------------------------------------------------------------------
+// CheckFile
+// 	Mark in "used" the header at "sector" and every sector of its
+//	file.  If the header is damaged, or any of those sectors is
+//	already marked (by another file, or twice by this one), mark
+//	nothing and return FALSE.
+//
+//	"sectors" -- room for SectorsFor(MaxFileSize) sector numbers
+//----------------------------------------------------------------------
+
+static bool
+CheckFile(int sector, BitMap *used, int *sectors)
+{
+    FileHeader *hdr;
+    int n, i;
+
+    if (sector < 0 || sector >= NumSectors || used->Test(sector))
+        return FALSE;
+    hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    n = hdr->AllSectors(sectors);
+    delete hdr;
+    if (n < 0)
+        return FALSE;
+
+    used->Mark(sector);
+    for (i = 0; i < n && !used->Test(sectors[i]); i++)
+        used->Mark(sectors[i]);
+    if (i == n)
+        return TRUE;
+    while (--i >= 0) // cross-linked: take it all back
+        used->Clear(sectors[i]);
+    used->Clear(sector);
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check the file system (like UNIX fsck): rebuild the bitmap from
+//	the file headers and index blocks of every file reachable from
+//	the root, and compare it with the real one.  Finds
+//	    names whose header is damaged, or whose file shares a sector
+//	      with a file found before it
+//	    sectors marked in use that no file has (leaked, e.g. by a
+//	      file removed while open when Nachos stopped)
+//	    sectors some file has, but marked free
+//	If "repair", bad names are removed (a bad directory takes what is
+//	below it along, which then counts as leaked), the bitmap is
+//	corrected, and the result committed.
+//
+//	The tree is walked a level at a time, each level in order of
+//	header sector, so the disk is read in one sweep per level rather
+//	than hopping back and forth.
+//
+//	Call it with no file open: the header of a file removed while
+//	open would look leaked.
+//----------------------------------------------------------------------
+
+int FileSystem::Check(bool repair)
+{
+    BitMap *used = new BitMap(NumSectors);
+    int *sectors = new int[FileHeader::SectorsFor(MaxFileSize)];
+    class List *level = new class List, *next; // not FileSystem::List
+    CheckEntry *e;
+    int numFiles = 0, numDirs = 1, numBad = 0, numLeaked = 0, numUnmarked = 0;
+
+    Enter();
+    Sync(); // so the disk has everything
+    for (int i = 0; i < JournalSectors; i++)
+        used->Mark(JournalSector + i);
+    if (!CheckFile(FreeMapSector, used, sectors) ||
+        !CheckFile(DirectorySector, used, sectors))
+    {
+        printf("The bitmap or root directory header is damaged.\n");
+        delete[] sectors;
+        delete used;
+        delete level;
+        Leave();
+        return 1;
+    }
+
+    QueueEntries(root, level);
+    while (!level->IsEmpty())
+    {
+        next = new class List;
+        while ((e = (CheckEntry *)level->SortedRemove(NULL)) != NULL)
+        {
+            if (CheckFile(e->sector, used, sectors))
+            {
+                if (e->isDir)
+                {
+                    numDirs++;
+                    QueueEntries(LoadDirectory(e->sector), next);
+                }
+                else
+                    numFiles++;
+            }
+            else
+            {
+                numBad++;
+                printf("%s (header at sector %d): damaged, or sharing "
+                       "sectors with another file\n", e->name, e->sector);
+                if (repair)
+                {
+                    e->parent->dir->Remove(e->name);
+                    if (e->sector >= 0 && e->sector < NumSectors &&
+                        !used->Test(e->sector))
+                    { // the header is nobody else's: forget it
+                        DropDirectory(e->sector);
+                        (void) inodeTable->Unlink(e->sector);
+                    }
+                }
+            }
+            delete e;
+        }
+        delete level;
+        level = next;
+    }
+    delete level;
+    delete[] sectors;
+
+    for (int i = 0; i < NumSectors; i++)
+    {
+        if (used->Test(i) && !freeMap->Test(i))
+        {
+            numUnmarked++;
+            if (repair)
+                freeMap->Mark(i);
+        }
+        else if (!used->Test(i) && freeMap->Test(i))
+        {
+            numLeaked++;
+            if (repair)
+            {
+                freeMap->Clear(i);
+                bufferCache->Invalidate(i);
+            }
+        }
+    }
+    delete used;
+
+    printf("Checked %d files, %d directories: %d bad names, %d sectors "
+           "leaked, %d in use but marked free.\n",
+           numFiles, numDirs, numBad, numLeaked, numUnmarked);
+    if (repair && numBad + numLeaked + numUnmarked > 0)
+    {
+        delete nameCache; // names may have gone
+        nameCache = new NameCache;
+        Sync();
+        printf("Repaired.\n");
+    }
+    Leave();
+    return numBad + numLeaked + numUnmarked;
 }
@@ -20,14 +20,28 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
-//	In addition, there is a bitmap for allocating
+//	in the file system.  There is a "root" directory, listing files
+//	and further directories by name; as in UNIX, a file is named by
+//	the path of directories leading to it ("/usr/log").  There are no
+//	"." or ".." entries, and no current directory: every path starts
+//	at the root.  In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
 //	bootstrap problem when the simulated disk is initialized. 
 //
+//	Every operation that changes the file system (and so the journal)
+//	holds the file system lock.  Looking a path up does not: Open
+//	walks the directories in memory without any lock, much like an
+//	RCU reader in UNIX.  Nachos only switches threads when one blocks,
+//	so a lookup that doesn't block sees the directories either before
+//	or after any change, never in the middle of one -- as long as
+//	changes are made in memory without blocking half-way (a new entry
+//	is added only once what it points at is ready, and a removed
+//	directory is freed only once its entry is gone).  If a directory
+//	on the path has to be read in from disk, Open takes the lock and
+//	looks the path up again.  Reads and writes of open files take
+//	the lock only to change the bitmap or a header (cf. inodetable.h).
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -37,6 +51,7 @@
 
 #include "copyright.h"
 #include "openfile.h"
+#include "namecache.h"
 
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
@@ -65,6 +80,29 @@ class FileSystem {
 };
 
 #else // FILESYS
+class BitMap;
+class Lock;
+class Directory;
+class DirectoryEntry;
+class FileHeader;
+
+// Number of file system operations committed together by the metadata
+// journal (cf. journal.h) -- the "group" in group commit.
+#define JournalGroupSize 16
+
+// A directory the file system has read in.  Like the root, a directory
+// stays in memory, with its file open, once it has been used.
+struct OpenDirectory {
+    int sector;				// Where the directory's header is
+    OpenFile *file;			// The directory file (journaled)
+    Directory *dir;			// Its contents
+    int reserved;			// Sectors set aside for the growth
+					// of its file at the next commit
+    OpenDirectory *next;		// Next one in the same hash chain
+};
+
+#define DirCacheSize 32			// Hash chains of open directories
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -73,6 +111,8 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// Release the in-memory bitmap and
+					// directories (call Sync first!)
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
@@ -81,15 +121,90 @@ class FileSystem {
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool Mkdir(char *name);		// Create a directory (UNIX mkdir)
+
+    bool Rmdir(char *name);		// Delete an empty directory
+					// (UNIX rmdir)
+
     void List();			// List all the files in the file system
+    bool IsDirectory(char *path);	// Is "path" a directory?
+    DirectoryEntry *ReadDir(char *path, int *index);
+					// Next name in directory "path"
+					// (UNIX readdir)
 
     void Print();			// List all the files and their contents
 
+    int Check(bool repair);		// Check that every sector is used
+					// by one file, or free (UNIX fsck);
+					// return how many problems were found
+
+    bool ExtendFile(FileHeader *hdr, int sector, int addBytes,
+                    int fromReserve = 0, bool writeBack = TRUE);
+					// Grow an open file, whose header
+					// is at "sector", by "addBytes"
+					// (using sectors set aside by Reserve)
+    void WriteHeader(FileHeader *hdr, int sector);
+					// Write back the header of an open
+					// file (one kept in its header, or
+					// one ExtendFile didn't write)
+    bool Reserve(int numSectors);	// Set free sectors aside for data
+					// that will be allocated later
+    void Unreserve(int numSectors);	// Give them back
+    void EndOp();			// Called at the end of every
+					// operation; commit if a group of
+					// them is complete
+    void MakeRoom(int numSectors);	// Commit now if the journal might
+					// not take "numSectors" more
+
+    void Sync();			// Commit every change made so far
+
+    void FreeLater(int sector);		// Free the file whose header is at
+					// "sector" at the next commit
+
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
-   OpenFile* directoryFile;		// "Root" directory -- list of 
+   OpenDirectory *root;			// "Root" directory -- list of 
 					// file names, represented as a file
+   OpenDirectory *dirCache[DirCacheSize]; // Every directory read in,
+					// hashed by header sector
+   BitMap *freeMap;			// In-memory copy of the bitmap
+   NameCache *nameCache;		// Path names recently opened
+
+   int deferredFree[JournalGroupSize];	// Headers of files removed since
+   int numDeferred;			// the last commit; their space is
+					// released by the next commit
+   int numOps;				// Operations since the last commit
+   bool syncing;			// Inside Sync?
+   int reserved;			// Free sectors set aside by Reserve
+   Lock *lock;				// Held by every operation that
+					// changes the file system
+   int lockDepth;			// Times the holder has taken it
+   void Enter();			// Take the lock, or take it again
+   void Leave();			// Undo one Enter
+
+   bool HasRoom(int numSectors);	// Are there that many free sectors
+					// not set aside?
+   int DirectoryGrowth(OpenDirectory *d); // Sectors to set aside so
+					// that "d" can take one more name
+
+   OpenDirectory *LoadDirectory(int sector, bool fresh = FALSE);
+					// The directory whose header is at
+					// "sector", read in if need be
+   OpenDirectory *CachedDirectory(int sector);
+					// The directory at "sector", if it
+					// has been read in; else NULL
+   void DropDirectory(int sector);	// Forget a removed directory
+   OpenDirectory *FindParent(char *path, char *name,
+                             bool *uncached = NULL);
+					// Directory holding the last name
+					// of "path", which goes in "name"
+					// (if "uncached", give up on one
+					// not read in yet)
+   OpenDirectory *FindDirectory(char *path);
+					// The directory "path" names
+   void ListDirectory(OpenDirectory *d, int depth);
+					// List "d" and everything below it
 };
 
 #endif // FILESYS
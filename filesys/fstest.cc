@@ -7,6 +7,14 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   GrowTest -- grow a file one byte at a time through every
+//		level of the file header's index, then check it
+//	   DirTest -- make nested directories full of files, look every
+//		file up by path name, then remove it all
+//	   Benchmark -- time a set of typical workloads, in simulated
+//		ticks, disk operations and host time
+//	   ConcurrentTest -- threads reading one file while another
+//		rewrites it, and creating and removing files of their own
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -16,8 +24,10 @@
 
 #include "utility.h"
 #include "filesys.h"
+#include "filehdr.h"
 #include "system.h"
 #include "thread.h"
+#include "synch.h"
 #include "disk.h"
 #include "stats.h"
 
@@ -194,3 +204,409 @@ void PerformanceTest()
     }
     stats->Print();
 }
+
+//----------------------------------------------------------------------
+// GrowTest
+// 	Grow a file one byte at a time up to "size" bytes, so that it
+//	goes through the direct blocks and then each level of indirect
+//	index blocks in the file header, then read it back and check every
+//	byte.  If the disk fills up first, the test checks the part that
+//	was written.  To get past a few hundred KB, build Nachos with a
+//	larger simulated disk (-DNumTracks=1024 gives 4MB).
+//----------------------------------------------------------------------
+
+#define GrowFileName "GrowFile"
+#define GrowByte(i) ((char)('a' + (i) % 26))
+
+void GrowTest(int size)
+{
+    OpenFile *openFile;
+    char *buffer;
+    char ch;
+    int i, length;
+
+    printf("Growing a file byte by byte to %d bytes (max file size %d)\n",
+           size, MaxFileSize);
+    stats->Print();
+    if (!fileSystem->Create(GrowFileName, 0))
+    {
+        printf("Grow test: can't create %s\n", GrowFileName);
+        return;
+    }
+    if ((openFile = fileSystem->Open(GrowFileName)) == NULL)
+    {
+        printf("Grow test: unable to open %s\n", GrowFileName);
+        return;
+    }
+    for (i = 0; i < size; i++)
+    {
+        ch = GrowByte(i);
+        if (openFile->Write(&ch, 1) != 1)
+        {
+            printf("Grow test: disk full after %d bytes\n", i);
+            break;
+        }
+    }
+    delete openFile;
+
+    // re-open, so the header and its index blocks come from disk
+    openFile = fileSystem->Open(GrowFileName);
+    length = openFile->Length();
+    if (length != i)
+        printf("Grow test: file is %d bytes, expected %d\n", length, i);
+    buffer = new char[SectorSize];
+    for (i = 0; i < length; i += SectorSize)
+    {
+        int numBytes = openFile->Read(buffer, SectorSize);
+        for (int j = 0; j < numBytes; j++)
+            if (buffer[j] != GrowByte(i + j))
+            {
+                printf("Grow test: wrong byte at %d\n", i + j);
+                delete[] buffer;
+                delete openFile;
+                return;
+            }
+    }
+    delete[] buffer;
+    delete openFile;
+    if (!fileSystem->Remove(GrowFileName))
+    {
+        printf("Grow test: unable to remove %s\n", GrowFileName);
+        return;
+    }
+    printf("Grow test: %d bytes written and verified\n", length);
+    stats->Print();
+}
+
+//----------------------------------------------------------------------
+// DirTest
+// 	Build a small tree of directories, put "numFiles" files in the
+//	deepest one, and check that each of them can be found by its path
+//	name (lookups go through each directory's hash table, so this
+//	should stay fast as "numFiles" grows).  Then take the tree apart
+//	again, checking that a directory can't be removed while it still
+//	has something in it.
+//----------------------------------------------------------------------
+
+#define DirTestDepth 3
+
+void DirTest(int numFiles)
+{
+    char path[64];
+    OpenFile *openFile;
+    int i;
+
+    printf("Directory test: %d files, %d levels deep\n", numFiles, DirTestDepth);
+    stats->Print();
+    path[0] = '\0';
+    for (i = 0; i < DirTestDepth; i++)
+    {
+        sprintf(path + strlen(path), "/dir%d", i);
+        if (!fileSystem->Mkdir(path))
+        {
+            printf("Directory test: can't make %s\n", path);
+            return;
+        }
+    }
+    for (i = 0; i < numFiles; i++)
+    {
+        sprintf(path, "/dir0/dir1/dir2/file%d", i);
+        if (!fileSystem->Create(path, 0))
+        {
+            printf("Directory test: can't create %s (disk full?)\n", path);
+            numFiles = i;
+            break;
+        }
+    }
+    for (i = 0; i < numFiles; i++)
+    {
+        sprintf(path, "dir0//dir1/dir2/file%d", i); // same names, other spelling
+        if ((openFile = fileSystem->Open(path)) == NULL)
+        {
+            printf("Directory test: can't find %s\n", path);
+            return;
+        }
+        delete openFile;
+    }
+    if (fileSystem->Open("/dir0/dir1/nofile") != NULL ||
+        fileSystem->Open("/dir0/nodir/file0") != NULL ||
+        fileSystem->Open("/dir0/dir1") != NULL)
+        printf("Directory test: opened something that is not a file\n");
+    if (fileSystem->Rmdir("/dir0/dir1/dir2") && numFiles > 0)
+        printf("Directory test: removed a directory that was not empty\n");
+
+    for (i = 0; i < numFiles; i++)
+    {
+        sprintf(path, "/dir0/dir1/dir2/file%d", i);
+        if (!fileSystem->Remove(path))
+        {
+            printf("Directory test: can't remove %s\n", path);
+            return;
+        }
+    }
+    for (i = DirTestDepth - 1; i >= 0; i--)
+    {
+        path[0] = '\0';
+        for (int j = 0; j <= i; j++)
+            sprintf(path + strlen(path), "/dir%d", j);
+        if (!fileSystem->Rmdir(path))
+        {
+            printf("Directory test: can't remove %s\n", path);
+            return;
+        }
+    }
+    printf("Directory test: %d files created, found and removed\n", numFiles);
+    stats->Print();
+}
+
+//----------------------------------------------------------------------
+// Benchmark
+// 	Measure the file system on a set of workloads, run one after the
+//	other:
+//	   seq-write   write a "fileSize" byte file, BenchChunk bytes at a time
+//	   seq-read    read it back the same way
+//	   rand-write  write BenchChunk bytes at as many random places in it
+//	   rand-read   read BenchChunk bytes at as many random places in it
+//	   grow        grow another file to "fileSize" bytes by GrowChunk
+//			byte appends
+//	   storm       create, write (BenchSmallFile bytes) and remove
+//			"numFiles" files, one at a time
+//	   dir-scan    open every one of "numFiles" files in a directory
+//
+//	For each, print the number of operations, the simulated ticks
+//	and the disk reads and writes (from "stats") it took, and the
+//	host time per operation.  Each workload ends with a commit, so
+//	that the work it leaves behind is charged to it.  Start from a
+//	freshly formatted disk for results that can be compared.
+//----------------------------------------------------------------------
+
+#define BenchFileName "BenchFile"
+#define BenchGrowName "BenchGrow"
+#define BenchDirName "/BenchDir"
+#define BenchChunk 100
+#define GrowChunk 10
+#define BenchSmallFile 200
+
+static int benchTicks, benchReads, benchWrites;
+static double benchStart;
+
+static void
+BenchStart()
+{
+    benchTicks = stats->totalTicks;
+    benchReads = stats->numDiskReads;
+    benchWrites = stats->numDiskWrites;
+    benchStart = HostMicroseconds();
+}
+
+static void
+BenchReport(char *name, int ops)
+{
+    int ticks;
+    double micros;
+
+    fileSystem->Sync();
+    ticks = stats->totalTicks - benchTicks;
+    micros = HostMicroseconds() - benchStart;
+    if (ops == 0)
+        ops = 1; // nothing done: don't divide by zero
+    printf("%-10s %7d ops %10d ticks (%6d/op) %6d reads %6d writes %9.1f us/op\n",
+           name, ops, ticks, ticks / ops, stats->numDiskReads - benchReads,
+           stats->numDiskWrites - benchWrites, micros / ops);
+}
+
+void Benchmark(int fileSize, int numFiles)
+{
+    OpenFile *openFile;
+    char *buffer = new char[max(BenchChunk, BenchSmallFile)];
+    char path[40];
+    int i, ops;
+
+    printf("File system benchmark: %d byte files, %d small files\n",
+           fileSize, numFiles);
+    for (i = 0; i < max(BenchChunk, BenchSmallFile); i++)
+        buffer[i] = 'a' + i % 26;
+    if (fileSize < BenchChunk || !fileSystem->Create(BenchFileName, 0) ||
+        !fileSystem->Create(BenchGrowName, 0) || !fileSystem->Mkdir(BenchDirName))
+    {
+        printf("Benchmark: can't set up (file size too small, or disk not empty?)\n");
+        delete[] buffer;
+        return;
+    }
+    ops = fileSize / BenchChunk;
+
+    openFile = fileSystem->Open(BenchFileName);
+    BenchStart();
+    for (i = 0; i < ops; i++)
+        if (openFile->Write(buffer, BenchChunk) != BenchChunk)
+            break; // disk full
+    ops = i;
+    BenchReport("seq-write", ops);
+
+    openFile->Seek(0);
+    BenchStart();
+    for (i = 0; i < ops; i++)
+        openFile->Read(buffer, BenchChunk);
+    BenchReport("seq-read", ops);
+
+    BenchStart();
+    for (i = 0; i < ops; i++)
+        openFile->WriteAt(buffer, BenchChunk, Random() % (ops * BenchChunk - BenchChunk + 1));
+    BenchReport("rand-write", ops);
+
+    BenchStart();
+    for (i = 0; i < ops; i++)
+        openFile->ReadAt(buffer, BenchChunk, Random() % (ops * BenchChunk - BenchChunk + 1));
+    BenchReport("rand-read", ops);
+    delete openFile;
+
+    openFile = fileSystem->Open(BenchGrowName);
+    BenchStart();
+    for (i = 0; i < fileSize / GrowChunk; i++)
+        if (openFile->Write(buffer, GrowChunk) != GrowChunk)
+            break; // disk full
+    BenchReport("grow", i);
+    delete openFile;
+    fileSystem->Remove(BenchGrowName);
+    fileSystem->Remove(BenchFileName);
+    fileSystem->Sync(); // give their space back
+
+    BenchStart();
+    for (i = 0; i < numFiles; i++)
+    {
+        sprintf(path, "BenchSmall%d", i);
+        if (!fileSystem->Create(path, 0))
+            break; // disk full
+        openFile = fileSystem->Open(path);
+        openFile->Write(buffer, BenchSmallFile);
+        delete openFile;
+        fileSystem->Remove(path);
+    }
+    BenchReport("storm", i);
+
+    for (ops = 0; ops < numFiles; ops++)
+    {
+        sprintf(path, "%s/f%d", BenchDirName, ops);
+        if (!fileSystem->Create(path, 0))
+            break; // disk full
+    }
+    fileSystem->Sync();
+    BenchStart();
+    for (i = 0; i < ops; i++)
+    {
+        sprintf(path, "%s/f%d", BenchDirName, i);
+        delete fileSystem->Open(path);
+    }
+    BenchReport("dir-scan", ops);
+    for (i = 0; i < ops; i++)
+    {
+        sprintf(path, "%s/f%d", BenchDirName, i);
+        fileSystem->Remove(path);
+    }
+    fileSystem->Rmdir(BenchDirName);
+    delete[] buffer;
+}
+
+//----------------------------------------------------------------------
+// ConcurrentTest
+// 	Fork "numReaders" threads reading one file, and one thread
+//	rewriting it.  The writer rewrites the whole file with one WriteAt
+//	each round, all of it one letter, a different one every round;
+//	each reader opens the file by name and reads all of it with one
+//	ReadAt, checking that it is all the same letter (no read ever sees
+//	part of a write).  Every thread also creates, writes and removes a
+//	file of its own each round.  Run with -rs, so that the threads are
+//	switched at random points.
+//----------------------------------------------------------------------
+
+#define ConcFileName "/ConcFile"
+#define ConcFileSize 1000
+#define ConcRounds 10
+
+static Semaphore *concDone; // V'ed by each thread when it is done
+static int concErrors;
+
+static void
+ConcThread(_int which)
+{
+    char *buffer = new char[ConcFileSize];
+    char path[40];
+    OpenFile *openFile;
+    int i, same;
+
+    sprintf(path, "%s%d", ConcFileName, (int)which);
+    for (int round = 0; round < ConcRounds; round++)
+    {
+        openFile = fileSystem->Open(ConcFileName);
+        if (which == 0)
+        { // the writer
+            memset(buffer, 'a' + round % 26, ConcFileSize);
+            if (openFile->WriteAt(buffer, ConcFileSize, 0) != ConcFileSize)
+                concErrors++;
+        }
+        else
+        { // a reader
+            i = openFile->ReadAt(buffer, ConcFileSize, 0);
+            for (same = 1; same < i && buffer[same] == buffer[0]; same++)
+                ;
+            if (i != ConcFileSize || same != i)
+            {
+                printf("Concurrent test: thread %d read a half-written file\n",
+                       (int)which);
+                concErrors++;
+            }
+        }
+        delete openFile;
+
+        if (!fileSystem->Create(path, 0) ||
+            (openFile = fileSystem->Open(path)) == NULL)
+        {
+            printf("Concurrent test: can't create %s\n", path);
+            concErrors++;
+            break;
+        }
+        openFile->Write(buffer, ConcFileSize);
+        delete openFile;
+        if (!fileSystem->Remove(path))
+            concErrors++;
+        currentThread->Yield();
+    }
+    delete[] buffer;
+    concDone->V();
+}
+
+void ConcurrentTest(int numReaders)
+{
+    char *buffer = new char[ConcFileSize];
+    OpenFile *openFile;
+    Thread *t;
+
+    printf("Concurrent test: %d readers, 1 writer, %d rounds\n",
+           numReaders, ConcRounds);
+    memset(buffer, 'z', ConcFileSize);
+    if (!fileSystem->Create(ConcFileName, 0) ||
+        (openFile = fileSystem->Open(ConcFileName)) == NULL)
+    {
+        printf("Concurrent test: can't create %s\n", ConcFileName);
+        delete[] buffer;
+        return;
+    }
+    openFile->Write(buffer, ConcFileSize);
+    delete openFile;
+    delete[] buffer;
+
+    concDone = new Semaphore("concurrent test", 0);
+    concErrors = 0;
+    for (int i = 0; i <= numReaders; i++)
+    {
+        t = new Thread("concurrent test");
+        t->Fork(ConcThread, i);
+    }
+    for (int i = 0; i <= numReaders; i++)
+        concDone->P();
+    delete concDone;
+
+    fileSystem->Remove(ConcFileName);
+    printf("Concurrent test: %d errors\n", concErrors);
+    stats->Print();
+}
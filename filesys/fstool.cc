@@ -0,0 +1,481 @@
+// fstool.cc
+//	A UNIX program (not part of Nachos) to fill a Nachos DISK image
+//	from UNIX files, or to copy files back out of one, without booting
+//	the kernel.
+//
+//	The file system code is the kernel's own (FileSystem, OpenFile,
+//	FileHeader, Directory, BitMap, the journal and the caches), so the
+//	image comes out exactly as Nachos would have written it.  What
+//	this file adds are stand-ins for the parts of the machine and of
+//	the thread system they use:
+//	   SynchDisk reads and writes the UNIX file holding the disk
+//		directly, with no simulated seek or rotation and no interrupt
+//	   Lock, RWLock and Condition do nothing, since only one thread
+//		runs
+//	   Thread::Fork does nothing: the buffer cache's read-ahead
+//		thread never runs, which is fine, since read-ahead is a hint
+//
+//	So copying a tree of files in is a matter of milliseconds, instead
+//	of booting Nachos once per file and paying for every sector in
+//	simulated time (cf. Copy in fstest.cc).
+//
+// Usage: fstool -d <debugflags> -disk <UNIX file> -f
+//		-cp <UNIX file or directory> <Nachos path>
+//		-get <Nachos path> <UNIX file or directory>
+//		-l -ck -fix
+//
+//    -d causes certain debugging messages to be printed (cf. utility.h)
+//    -disk names the UNIX file holding the disk (default "DISK")
+//    -f formats the disk first
+//    -cp copies a UNIX file into Nachos; a UNIX directory is copied
+//	with everything below it, as Nachos directories
+//    -get copies a Nachos file out to UNIX; a Nachos directory is
+//	copied with everything below it ("/" is the whole disk)
+//    -l lists the Nachos directories
+//    -ck, -fix check the file system (and repair it), as in nachos
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include "system.h"
+#include "directory.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Same as in disk.cc: the UNIX file starts with a magic number, and
+// then holds every sector of the disk in order.
+#define MagicNumber 0x456789ab
+#define MagicSize sizeof(int)
+#define DiskSize (MagicSize + (NumSectors * SectorSize))
+
+#define MaxToolPath 512 // longest path name, UNIX or Nachos
+
+// The globals of system.h that the file system uses
+Thread *currentThread;
+Thread *threadToBeDestroyed;
+Scheduler *scheduler;
+Interrupt *interrupt;
+Statistics *stats;
+Timer *timer;
+FileSystem *fileSystem;
+SynchDisk *synchDisk;
+Journal *journal;
+InodeTable *inodeTable;
+BufferCache *bufferCache;
+
+static int diskFile; // The UNIX file holding the disk
+static int numFiles, numDirs, numBytes; // What was copied
+
+//----------------------------------------------------------------------
+// SynchDisk::SynchDisk
+// 	Open the UNIX file holding the disk, creating it if it doesn't
+//	exist, and check the magic number (as Disk::Disk does).
+//----------------------------------------------------------------------
+
+SynchDisk::SynchDisk(char *name)
+{
+    int magicNum;
+    int tmp = 0;
+
+    diskFile = OpenForReadWrite(name, FALSE);
+    if (diskFile >= 0)
+    { // file exists, check magic number
+        Read(diskFile, (char *)&magicNum, MagicSize);
+        ASSERT(magicNum == MagicNumber);
+    }
+    else
+    { // file doesn't exist, create it
+        diskFile = OpenForWrite(name);
+        magicNum = MagicNumber;
+        WriteFile(diskFile, (char *)&magicNum, MagicSize);
+        Lseek(diskFile, DiskSize - sizeof(int), 0);
+        WriteFile(diskFile, (char *)&tmp, sizeof(int));
+    }
+}
+
+SynchDisk::~SynchDisk()
+{
+    Close(diskFile);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSector/WriteSector
+// 	Read or write one sector of the UNIX file, right away.
+//----------------------------------------------------------------------
+
+void SynchDisk::ReadSector(int sectorNumber, char *data)
+{
+    ASSERT(sectorNumber >= 0 && sectorNumber < NumSectors);
+    Lseek(diskFile, MagicSize + sectorNumber * SectorSize, 0);
+    Read(diskFile, data, SectorSize);
+    stats->numDiskReads++;
+}
+
+void SynchDisk::WriteSector(int sectorNumber, char *data)
+{
+    ASSERT(sectorNumber >= 0 && sectorNumber < NumSectors);
+    Lseek(diskFile, MagicSize + sectorNumber * SectorSize, 0);
+    WriteFile(diskFile, data, SectorSize);
+    stats->numDiskWrites++;
+}
+
+void SynchDisk::RequestDone()
+{
+}
+
+//----------------------------------------------------------------------
+// Lock, RWLock, Condition, Thread
+// 	Only one thread ever runs here, so a lock is never contended and
+//	nobody ever waits on a condition.  A lock still remembers that it
+//	is held, for isHeldByCurrentThread (and TryAcquireWrite).
+//----------------------------------------------------------------------
+
+Lock::Lock(char *debugName)
+{
+    name = debugName;
+    owner = NULL;
+    lock = NULL;
+}
+
+Lock::~Lock()
+{
+}
+
+void Lock::Acquire()
+{
+    ASSERT(owner == NULL);
+    owner = currentThread;
+}
+
+void Lock::Release()
+{
+    ASSERT(owner == currentThread);
+    owner = NULL;
+}
+
+bool Lock::isHeldByCurrentThread()
+{
+    return owner == currentThread;
+}
+
+RWLock::RWLock(char *debugName)
+{
+    name = debugName;
+    lock = NULL;
+    readable = NULL;
+    writable = NULL;
+    numReaders = 0;
+    numWaitingWriters = 0;
+    writer = NULL;
+}
+
+RWLock::~RWLock()
+{
+}
+
+void RWLock::AcquireRead()
+{
+    ASSERT(writer == NULL);
+    numReaders++;
+}
+
+void RWLock::ReleaseRead()
+{
+    ASSERT(numReaders > 0);
+    numReaders--;
+}
+
+void RWLock::AcquireWrite()
+{
+    ASSERT(TryAcquireWrite());
+}
+
+void RWLock::ReleaseWrite()
+{
+    ASSERT(writer == currentThread);
+    writer = NULL;
+}
+
+bool RWLock::TryAcquireWrite()
+{
+    if (writer != NULL || numReaders > 0)
+        return FALSE;
+    writer = currentThread;
+    return TRUE;
+}
+
+bool RWLock::isHeldByCurrentThread()
+{
+    return writer == currentThread;
+}
+
+Condition::Condition(char *debugName)
+{
+    name = debugName;
+    queue = NULL;
+    lock = NULL;
+}
+
+Condition::~Condition()
+{
+}
+
+void Condition::Wait(Lock *conditionLock)
+{
+    ASSERT(FALSE); // would wait forever
+}
+
+void Condition::Signal(Lock *conditionLock)
+{
+}
+
+void Condition::Broadcast(Lock *conditionLock)
+{
+}
+
+Thread::Thread(char *threadName)
+{
+    name = threadName;
+    stackTop = NULL;
+    stack = NULL;
+    status = JUST_CREATED;
+}
+
+void Thread::Fork(VoidFunctionPtr func, _int arg)
+{
+}
+
+//----------------------------------------------------------------------
+// JoinPath
+// 	Put "dir/name" into "path", and return FALSE if it doesn't fit.
+//----------------------------------------------------------------------
+
+static bool
+JoinPath(char *path, char *dir, char *name)
+{
+    int len = strlen(dir);
+
+    if (len > 0 && dir[len - 1] == '/')
+        len--;
+    if (len + 1 + strlen(name) >= MaxToolPath)
+        return FALSE;
+    sprintf(path, "%.*s/%s", len, dir, name);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Import
+// 	Copy the UNIX file "from" to the Nachos file "to", in one Write
+//	to a file created at its full size (so its sectors are allocated
+//	together, and then written straight from our buffer).  If "from"
+//	is a directory, make "to" a directory and copy what is in it.
+//----------------------------------------------------------------------
+
+static void
+Import(char *from, char *to)
+{
+    struct stat st;
+    OpenFile *openFile;
+    char *buffer;
+    FILE *fp;
+
+    if (stat(from, &st) < 0)
+    {
+        printf("fstool: can't find %s\n", from);
+        return;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        char fromPath[MaxToolPath], toPath[MaxToolPath];
+        struct dirent *entry;
+        DIR *dir;
+
+        if (!fileSystem->Mkdir(to) && !fileSystem->IsDirectory(to))
+        {
+            printf("fstool: couldn't make directory %s\n", to);
+            return;
+        }
+        numDirs++;
+        if ((dir = opendir(from)) == NULL)
+            return;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+                continue;
+            if (strlen(entry->d_name) > FileNameMaxLen ||
+                !JoinPath(fromPath, from, entry->d_name) ||
+                !JoinPath(toPath, to, entry->d_name))
+            {
+                printf("fstool: name too long, skipped %s\n", entry->d_name);
+                continue;
+            }
+            Import(fromPath, toPath);
+        }
+        closedir(dir);
+        return;
+    }
+
+    DEBUG('f', "Importing %s, size %d, to %s\n", from, (int)st.st_size, to);
+    if ((fp = fopen(from, "r")) == NULL)
+    {
+        printf("fstool: couldn't open %s\n", from);
+        return;
+    }
+    fileSystem->Remove(to); // replace any earlier copy
+    if (!fileSystem->Create(to, st.st_size))
+    {
+        printf("fstool: couldn't create %s (disk full?)\n", to);
+        fclose(fp);
+        return;
+    }
+    openFile = fileSystem->Open(to);
+    ASSERT(openFile != NULL);
+    buffer = new char[st.st_size];
+    if (fread(buffer, sizeof(char), st.st_size, fp) == (size_t)st.st_size)
+        openFile->Write(buffer, st.st_size);
+    else
+        printf("fstool: couldn't read %s\n", from);
+    delete[] buffer;
+    delete openFile;
+    fclose(fp);
+    numFiles++;
+    numBytes += st.st_size;
+}
+
+//----------------------------------------------------------------------
+// Export
+// 	Copy the Nachos file "from" to the UNIX file "to".  If "from" is
+//	a directory, make the UNIX directory "to" and copy what is in it.
+//----------------------------------------------------------------------
+
+static void
+Export(char *from, char *to)
+{
+    OpenFile *openFile;
+    DirectoryEntry *entry;
+    char *buffer;
+    int index = 0, length;
+    FILE *fp;
+
+    if ((openFile = fileSystem->Open(from)) == NULL)
+    { // a directory, or nothing
+        char fromPath[MaxToolPath], toPath[MaxToolPath];
+
+        if (!fileSystem->IsDirectory(from))
+        {
+            printf("fstool: can't find %s\n", from);
+            return;
+        }
+        mkdir(to, 0777);
+        numDirs++;
+        while ((entry = fileSystem->ReadDir(from, &index)) != NULL)
+        {
+            if (!JoinPath(fromPath, from, entry->name) ||
+                !JoinPath(toPath, to, entry->name))
+            {
+                printf("fstool: path too long, skipped %s\n", entry->name);
+                continue;
+            }
+            Export(fromPath, toPath);
+        }
+        return;
+    }
+
+    DEBUG('f', "Exporting %s, size %d, to %s\n", from, openFile->Length(), to);
+    if ((fp = fopen(to, "w")) == NULL)
+    {
+        printf("fstool: couldn't create %s\n", to);
+        delete openFile;
+        return;
+    }
+    length = openFile->Length();
+    buffer = new char[length];
+    length = openFile->ReadAt(buffer, length, 0);
+    fwrite(buffer, sizeof(char), length, fp);
+    delete[] buffer;
+    delete openFile;
+    fclose(fp);
+    numFiles++;
+    numBytes += length;
+}
+
+//----------------------------------------------------------------------
+// main
+// 	Open (or format) the disk, do what the command line says, and
+//	commit the result.
+//----------------------------------------------------------------------
+
+int
+main(int argc, char **argv)
+{
+    char *debugArgs = "";
+    char *diskName = "DISK";
+    bool format = FALSE;
+    int argCount;
+    double start;
+
+    // the disk and the file system come first
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "-f"))
+            format = TRUE;
+        else if (!strcmp(argv[i], "-disk") && i + 1 < argc)
+            diskName = argv[++i];
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            debugArgs = argv[++i];
+
+    DebugInit(debugArgs);
+    stats = new Statistics();
+    currentThread = new Thread("main");
+    synchDisk = new SynchDisk(diskName);
+    journal = new Journal;
+    inodeTable = new InodeTable;
+    bufferCache = new BufferCache;
+    fileSystem = new FileSystem(format);
+
+    start = HostMicroseconds();
+    for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount)
+    {
+        argCount = 1;
+        if (!strcmp(*argv, "-d") || !strcmp(*argv, "-disk"))
+            argCount = 2; // done above
+        else if (!strcmp(*argv, "-cp"))
+        { // copy from UNIX to Nachos
+            ASSERT(argc > 2);
+            Import(*(argv + 1), *(argv + 2));
+            argCount = 3;
+        }
+        else if (!strcmp(*argv, "-get"))
+        { // copy from Nachos to UNIX
+            ASSERT(argc > 2);
+            Export(*(argv + 1), *(argv + 2));
+            argCount = 3;
+        }
+        else if (!strcmp(*argv, "-l"))
+            fileSystem->List();
+        else if (!strcmp(*argv, "-ck"))
+            fileSystem->Check(FALSE);
+        else if (!strcmp(*argv, "-fix"))
+            fileSystem->Check(TRUE);
+    }
+    fileSystem->Sync();
+
+    if (numFiles + numDirs > 0)
+        printf("Copied %d files, %d directories, %d bytes in %.1f ms "
+               "(%d sectors read, %d written)\n",
+               numFiles, numDirs, numBytes,
+               (HostMicroseconds() - start) / 1000.0,
+               stats->numDiskReads, stats->numDiskWrites);
+    delete fileSystem;
+    delete bufferCache;
+    delete inodeTable;
+    delete journal;
+    delete synchDisk;
+    return 0;
+}
@@ -0,0 +1,293 @@
+// inodetable.cc
+//	Routines to share the in-memory file headers of open files.
+//
+//	Entries whose files are all closed stay in the table (so the
+//	next open is free) until there are more than InodeCacheSize
+//	entries; then the entry is dropped as soon as it is closed.
+//	The header on disk is always up to date (whoever changes a header
+//	writes it back), so dropping an entry never loses anything.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "inodetable.h"
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty table.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    for (int i = 0; i < InodeHashSize; i++)
+        table[i] = NULL;
+    numInodes = 0;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the table, and every header still in it.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    for (int i = 0; i < InodeHashSize; i++)
+        while (table[i] != NULL)
+            Delete(&table[i]);
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the entry for the file header at "sector", reading the
+//	header in if it isn't in the table yet, and count one more user.
+//	If another thread is reading the header in, wait for it.
+//----------------------------------------------------------------------
+
+Inode *
+InodeTable::Get(int sector)
+{
+    Inode **link = Link(sector);
+    Inode *inode = *link;
+
+    if (inode != NULL)
+    {
+        inode->refCount++;
+        if (inode->loading)
+        { // the thread reading it in holds the lock until it is done
+            inode->lock->AcquireRead();
+            inode->lock->ReleaseRead();
+        }
+        return inode;
+    }
+
+    inode = new Inode;
+    inode->sector = sector;
+    inode->hdr = new FileHeader;
+    inode->refCount = 1;
+    inode->removed = FALSE;
+    inode->lock = new RWLock("inode");
+    inode->loading = TRUE;
+    inode->length = 0;
+    inode->reserved = 0;
+    inode->firstDelayed = -1;
+    inode->numDelayed = 0;
+    inode->next = NULL;
+    *link = inode; // before we block: nobody else reads it in too
+    numInodes++;
+
+    inode->lock->AcquireWrite();
+    inode->hdr->FetchFrom(sector);
+    inode->length = inode->hdr->FileLength();
+    inode->loading = FALSE;
+    inode->lock->ReleaseWrite();
+    return inode;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	Drop a reference to "inode".  When the last one goes, the delayed
+//	sectors are written (or, for a removed file, thrown away), a
+//	removed file's space is handed to the file system to be freed, and
+//	any entry may be dropped if the table has grown too big.
+//
+//	The last reference is only dropped once the sectors are written:
+//	the file may be opened again, or removed, while we wait for the
+//	disk.  Nobody else can hold the lock then (they would have a
+//	reference), so we never wait for it.
+//----------------------------------------------------------------------
+
+void InodeTable::Put(Inode *inode)
+{
+    int sector = inode->sector;
+    bool free;
+
+    ASSERT(inode->refCount > 0);
+    if (inode->refCount > 1)
+    {
+        inode->refCount--;
+        return;
+    }
+    free = inode->lock->TryAcquireWrite();
+    ASSERT(free);
+    if (!inode->removed)
+    {
+        FlushDelayed(inode);
+        fileSystem->Unreserve(inode->reserved); // anything left over
+        inode->reserved = 0;
+    }
+    inode->lock->ReleaseWrite();
+
+    if (--inode->refCount > 0)
+        return; // opened again meanwhile
+    if (inode->removed)
+    {
+        fileSystem->Unreserve(inode->reserved); // nobody can read it
+        Delete(Link(sector));
+        fileSystem->FreeLater(sector);
+    }
+    else if (numInodes > InodeCacheSize)
+        Delete(Link(sector));
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Unlink
+// 	The file whose header is at "sector" has been removed from its
+//	directory.  If it is open, remember to free it on the last close
+//	and return TRUE; otherwise drop any cached header (the sector is
+//	about to be reused) and return FALSE.
+//----------------------------------------------------------------------
+
+bool InodeTable::Unlink(int sector)
+{
+    Inode **link = Link(sector);
+
+    if (*link == NULL)
+        return FALSE;
+    if ((*link)->refCount > 0)
+    {
+        (*link)->removed = TRUE;
+        return TRUE;
+    }
+    Delete(link);
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::FlushDelayed
+// 	Write the delayed sectors of "inode" (if it has any) to disk.  If
+//	appends have taken the file past the header's length, first give
+//	the file the sectors it now needs -- all at once, out of the space
+//	set aside for them -- and afterwards count that as one operation
+//	on the file system.  A file that (still) fits in its header gets
+//	the data copied there instead, which is an operation too.  The
+//	caller holds the file's lock for writing.
+//
+//	The grown header only goes to the journal once the data is on
+//	disk: writing the data blocks, and another thread may commit
+//	meanwhile, which must not take a header pointing at sectors that
+//	still hold stale data.
+//----------------------------------------------------------------------
+
+void InodeTable::FlushDelayed(Inode *inode)
+{
+    FileHeader *hdr = inode->hdr;
+    int first = inode->firstDelayed;
+    int used;
+    bool grown = FALSE;
+
+    if (first < 0)
+        return;
+    inode->firstDelayed = -1; // a commit while we grow mustn't come here
+    if (inode->length > hdr->FileLength())
+    { // the rest of what is reserved is for a write still going on
+        used = FileHeader::SectorsFor(inode->length) -
+               FileHeader::SectorsFor(hdr->FileLength());
+        ASSERT(used <= inode->reserved);
+        grown = fileSystem->ExtendFile(hdr, inode->sector,
+                                       inode->length - hdr->FileLength(), used,
+                                       FALSE); // written once the data is
+        ASSERT(grown); // there was room: it was reserved
+        inode->reserved -= used;
+    }
+    DEBUG('f', "Writing %d delayed sectors from sector %d of file %d.\n",
+          inode->numDelayed, first, inode->sector);
+    if (hdr->IsInline())
+    {
+        ASSERT(first == 0 && inode->numDelayed == 1);
+        hdr->WriteInline(inode->delayed);
+        grown = TRUE; // the header changed, as if it had grown
+    }
+    else
+        for (int i = 0; i < inode->numDelayed; i++)
+            bufferCache->WriteSector(hdr->ByteToSector((first + i) * SectorSize),
+                                     &inode->delayed[i * SectorSize]);
+    inode->numDelayed = 0;
+    if (grown)
+    {
+        fileSystem->MakeRoom(1); // commits may have filled the journal
+        fileSystem->WriteHeader(hdr, inode->sector);
+        fileSystem->EndOp();
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Flush
+// 	Write the delayed sectors of every file, so that the data is on
+//	disk (and the bitmap and headers reflect it) before the file system
+//	commits.  The current thread may be in the middle of writing one
+//	of the files, in which case it already has the lock.
+//
+//	The caller holds the file system lock, which a thread writing a
+//	file may be waiting for; so a file whose lock another thread has
+//	is skipped rather than waited for.  Its delayed sectors have no
+//	disk sectors yet, so the commit is consistent without them; they
+//	go out with a later one.  Each file is finished before the next
+//	is started, so the file system may commit in between.
+//----------------------------------------------------------------------
+
+void InodeTable::Flush()
+{
+    Inode **delayed = new Inode *[numInodes];
+    int count = 0;
+
+    // keep every entry we are going to flush first: the table may
+    // change while we wait for the disk
+    for (int i = 0; i < InodeHashSize; i++)
+        for (Inode *inode = table[i]; inode != NULL; inode = inode->next)
+            if (inode->firstDelayed >= 0)
+            {
+                inode->refCount++;
+                delayed[count++] = inode;
+            }
+
+    for (int i = 0; i < count; i++)
+    {
+        Inode *inode = delayed[i];
+
+        fileSystem->MakeRoom(1); // its header, if it grows
+        if (inode->lock->isHeldByCurrentThread())
+            FlushDelayed(inode);
+        else if (inode->lock->TryAcquireWrite())
+        {
+            FlushDelayed(inode);
+            inode->lock->ReleaseWrite();
+        }
+        Put(inode);
+    }
+    delete[] delayed;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Link
+// 	Return a pointer to the link that points at the entry for
+//	"sector", or to the NULL link ending its chain if it has none.
+//----------------------------------------------------------------------
+
+Inode **
+InodeTable::Link(int sector)
+{
+    Inode **link = &table[sector % InodeHashSize];
+
+    while (*link != NULL && (*link)->sector != sector)
+        link = &(*link)->next;
+    return link;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Delete
+// 	Unlink the entry "*link" points at, and free it.
+//----------------------------------------------------------------------
+
+void InodeTable::Delete(Inode **link)
+{
+    Inode *inode = *link;
+
+    *link = inode->next;
+    delete inode->hdr;
+    delete inode->lock;
+    delete inode;
+    numInodes--;
+}
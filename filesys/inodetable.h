@@ -0,0 +1,103 @@
+// inodetable.h
+//	Data structures for the system-wide table of open files' headers
+//	(in UNIX terms, the in-core inode table).
+//
+//	Every OpenFile of the same file shares one in-memory FileHeader,
+//	found in the table by the sector the header lives in.  So a file
+//	that grows through one OpenFile has grown for all of them, and
+//	opening a file that is already open (or was recently) reads
+//	nothing from disk.
+//
+//	Each entry also has a readers/writers lock: ReadAt holds it for
+//	reading, so any number of threads can read the same file at once,
+//	and WriteAt (which may grow the file) holds it for writing, so
+//	that a reader never sees a half-grown file.  Either holds it for
+//	the whole transfer.
+//
+//	The table itself has no lock.  Nachos runs one thread at a time,
+//	and only switches to another when the running thread blocks (on
+//	the disk, or on a lock), so a stretch of code that doesn't block
+//	is never interleaved with anything.  Finding or adding an entry
+//	and counting a reference never blocks; an entry is in the table
+//	(with its lock held for writing) before its header is read in, and
+//	keeps a reference while its delayed sectors are written out, so
+//	that nobody frees it while its owner waits for the disk.
+//
+//	A file removed while still open keeps its header and sectors
+//	until the last OpenFile on it is closed, as in UNIX.
+//
+//	Appends are gathered in the entry, not written: the last few
+//	sectors of the file (from the partly written sector the file ended
+//	in) are kept in memory, and the ones past the end of the header's
+//	length get no disk sectors yet -- only enough free sectors are set
+//	aside for them (cf. FileSystem::Reserve).  Reads look there first.
+//	When the buffer is full, when the file is closed for the last
+//	time, and before the file system commits, the file is grown in one
+//	step (so its new sectors can be allocated as one contiguous run,
+//	and the header and bitmap change once) and the buffer is written.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef INODETABLE_H
+#define INODETABLE_H
+
+#include "filehdr.h"
+#include "synch.h"
+
+#define InodeHashSize 64	// hash chains in the table
+#define InodeCacheSize 64	// closed files' headers kept around
+#define DelayedSectors 8	// sectors of appended data an entry keeps
+
+// The following class defines an entry of the table: one file's
+// header, shared by all OpenFiles of the file.
+class Inode {
+  public:
+    int sector;			// Where the header lives on disk
+    FileHeader *hdr;		// The shared header
+    int refCount;		// OpenFiles using this entry
+    bool removed;		// Removed while open: free on last close
+    RWLock *lock;		// Held for reading by ReadAt, and for
+				// writing by WriteAt
+    bool loading;		// Is the header still being read in?
+    int length;			// Length of the file, counting appended
+				// data not yet in the header
+    int reserved;		// Free sectors set aside for that data
+    int firstDelayed;		// First sector of the file kept in
+				// "delayed" (-1 if none)
+    int numDelayed;		// How many sectors are kept there
+    char delayed[DelayedSectors * SectorSize];
+				// The last sectors of the file, not
+				// written to disk yet
+    Inode *next;		// Next entry in the same hash chain
+};
+
+class InodeTable {
+  public:
+    InodeTable();		// Initialize an empty table
+    ~InodeTable();		// De-allocate the table
+
+    Inode *Get(int sector);	// Find (or read in) the header at
+				// "sector", and add a reference to it
+    void Put(Inode *inode);	// Drop a reference
+    bool Unlink(int sector);	// The file at "sector" was removed;
+				// return TRUE if it is still open (so
+				// its space must not be freed yet)
+    void FlushDelayed(Inode *inode);
+				// Grow the file over its delayed
+				// sectors and write them out
+    void Flush();		// FlushDelayed every file not in use
+
+  private:
+    Inode *table[InodeHashSize];
+    int numInodes;		// entries in the table
+
+    Inode **Link(int sector);	// Pointer to where "sector" is, or
+				// should be, in its chain
+    void Delete(Inode **link);	// Take an entry out, and free it
+};
+
+#endif // INODETABLE_H
@@ -0,0 +1,209 @@
+// journal.cc
+//	Routines to buffer, commit and replay writes of file system
+//	metadata sectors.  See journal.h for the protocol.
+//
+//	The journal does not know which writes belong to which file system
+//	operation; the file system only calls Commit between operations,
+//	and makes sure (cf. FileSystem::MakeRoom) that the journal never
+//	fills up in the middle of one.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "system.h"
+#include "journal.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty journal.  Format or Recover must be called
+//	before the file system is used.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    numPending = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  Writes still pending are lost, exactly as
+//	if Nachos had crashed; FileSystem::Sync should be called first.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    if (numPending > 0)
+        DEBUG('f', "Dropping %d uncommitted metadata sectors.\n", numPending);
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty journal header, for a freshly formatted disk.
+//----------------------------------------------------------------------
+
+void Journal::Format()
+{
+    JournalHeader header;
+
+    bzero((char *)&header, sizeof(header));
+    synchDisk->WriteSector(JournalSector, (char *)&header);
+    numPending = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	If the last commit did not finish copying its sectors home, copy
+//	them again from the journal area, then clear the journal.  Copying
+//	a sector home twice is harmless, so this is safe to repeat.
+//----------------------------------------------------------------------
+
+void Journal::Recover()
+{
+    JournalHeader header;
+    char buf[SectorSize];
+    char map[JournalMapSectors * SectorSize];
+    int *where = (int *)map;
+
+    synchDisk->ReadSector(JournalSector, (char *)&header);
+    if (header.magic != JournalMagic || header.count <= 0)
+        return; // clean shutdown, nothing to replay
+    ASSERT(header.count <= JournalCapacity);
+
+    DEBUG('f', "Replaying %d journaled sectors.\n", header.count);
+    for (int i = 0; i < divRoundUp(header.count * (int)sizeof(int), SectorSize); i++)
+        synchDisk->ReadSector(JournalSector + 1 + i, &map[i * SectorSize]);
+    for (int i = 0; i < header.count; i++)
+    {
+        synchDisk->ReadSector(ImageSector(i), buf);
+        synchDisk->WriteSector(where[i], buf);
+    }
+    Format();
+}
+
+//----------------------------------------------------------------------
+// Journal::ReadSector
+// 	Read a metadata sector, taking its pending (uncommitted) contents
+//	if it has been written since the last commit.
+//----------------------------------------------------------------------
+
+void Journal::ReadSector(int sector, char *data)
+{
+    int slot = Lookup(sector);
+
+    if (slot != -1)
+        bcopy(image[slot], data, SectorSize);
+    else
+        synchDisk->ReadSector(sector, data);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSector
+// 	Remember the new contents of a metadata sector until the next
+//	commit.  Writing the same sector again just replaces the image.
+//	The file system has made sure there is room (cf. Room).
+//----------------------------------------------------------------------
+
+void Journal::WriteSector(int sector, char *data)
+{
+    int slot = Lookup(sector);
+
+    if (slot == -1)
+    {
+        ASSERT(numPending < JournalCapacity);
+        slot = numPending++;
+        home[slot] = sector;
+    }
+    bcopy(data, image[slot], SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::Forget
+// 	Drop the pending write of "sector", because the sector has just
+//	been freed.  Otherwise the commit would later copy the stale image
+//	over whatever the sector is reused for.
+//----------------------------------------------------------------------
+
+void Journal::Forget(int sector)
+{
+    int slot = Lookup(sector);
+
+    if (slot == -1)
+        return;
+    numPending--;
+    if (slot != numPending)
+    { // keep the pending sectors packed
+        home[slot] = home[numPending];
+        bcopy(image[numPending], image[slot], SectorSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write every pending sector, and the map of where each belongs, to
+//	the journal area, commit them by writing the journal header, copy
+//	them home, and clear the header.
+//----------------------------------------------------------------------
+
+void Journal::Commit()
+{
+    JournalHeader header;
+    char map[JournalMapSectors * SectorSize];
+    int mapSectors = divRoundUp(numPending * sizeof(int), SectorSize);
+
+    if (numPending == 0)
+        return;
+    DEBUG('f', "Committing %d metadata sectors.\n", numPending);
+
+    for (int i = 0; i < numPending; i++)
+        synchDisk->WriteSector(ImageSector(i), image[i]);
+    bzero(map, sizeof(map));
+    bcopy((char *)home, map, numPending * sizeof(int));
+    for (int i = 0; i < mapSectors; i++) // only the part in use
+        synchDisk->WriteSector(JournalSector + 1 + i, &map[i * SectorSize]);
+
+    bzero((char *)&header, sizeof(header));
+    header.magic = JournalMagic;
+    header.count = numPending;
+    synchDisk->WriteSector(JournalSector, (char *)&header); // commit point
+
+    for (int i = 0; i < numPending; i++)
+        synchDisk->WriteSector(home[i], image[i]);
+    numPending = 0;
+    Format(); // the sectors are home, nothing left to replay
+}
+
+//----------------------------------------------------------------------
+// Journal::NumPending
+// 	Return how many sectors are waiting for the next commit.
+//----------------------------------------------------------------------
+
+int Journal::NumPending()
+{
+    return numPending;
+}
+
+//----------------------------------------------------------------------
+// Journal::Room
+// 	Return how many more sectors can be written before a commit.
+//----------------------------------------------------------------------
+
+int Journal::Room()
+{
+    return JournalCapacity - numPending;
+}
+
+//----------------------------------------------------------------------
+// Journal::Lookup
+// 	Return the slot holding the pending image of "sector", or -1.
+//----------------------------------------------------------------------
+
+int Journal::Lookup(int sector)
+{
+    for (int i = 0; i < numPending; i++)
+        if (home[i] == sector)
+            return i;
+    return -1;
+}
@@ -0,0 +1,106 @@
+// journal.h
+//	Data structures for a small write-ahead journal of file system
+//	metadata.
+//
+//	The file system keeps the bitmap and the directory in memory, so
+//	an operation like Create or Remove no longer rewrites them on disk
+//	straight away.  Instead every metadata sector it changes (file
+//	headers, and the sectors of the bitmap and directory files) is
+//	handed to the journal, which keeps the newest image of each one
+//	in memory.  Several operations are then committed together (a
+//	"group commit"):
+//
+//	   the sector images are written to the journal area on disk
+//	   the journal header is written -- this is the commit point
+//	   the images are copied to their real ("home") locations
+//	   the journal header is cleared again
+//
+//	If Nachos stops in the middle, the next boot replays a committed
+//	journal (Recover), so a group of operations either happened
+//	entirely or not at all.  A sector written many times between two
+//	commits only costs two disk writes per commit.
+//
+//	The journal never commits on its own: a commit in the middle of
+//	an operation could reach the disk without the bitmap sectors that
+//	allocate what it points at.  Instead the file system commits (cf.
+//	FileSystem::MakeRoom) between steps that leave the disk consistent,
+//	whenever the next step might not fit.
+//
+//	Data sectors and index blocks are not journaled: they are only
+//	ever written to sectors the last commit considers free or unused
+//	(files only grow), so writing them straight away is safe.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "utility.h"
+
+// Sectors of the bitmap file: a commit may have to carry all of them.
+#define FreeMapSectors divRoundUp(NumSectors, 8 * SectorSize)
+
+// Sector images one commit can carry besides the bitmap: file headers
+// and directory sectors.  A group of operations (cf. JournalGroupSize)
+// changes far fewer, and the file system commits before a step that
+// might not fit, so this only bounds how often that happens.
+#define JournalMetaCapacity 48
+
+const int JournalCapacity = JournalMetaCapacity + FreeMapSectors;
+
+// The journal lives at a fixed place on disk, right after the headers
+// of the bitmap and directory files: one sector for the journal header,
+// then JournalMapSectors sectors saying where each logged image belongs,
+// followed by room for JournalCapacity sector images.  The header is
+// written last, so that writing it is the commit point.
+#define JournalSector 2                 // journal header (commit record)
+#define JournalMagic 0x4a524e4c         // marks a committed journal
+#define JournalMapSectors ((int)divRoundUp(JournalCapacity * sizeof(int), SectorSize))
+#define JournalSectors (1 + JournalMapSectors + JournalCapacity)
+                                        // sectors reserved on disk
+
+// On-disk format of the journal header: exactly one sector.
+struct JournalHeader
+{
+  int magic;                     // JournalMagic if committed
+  int count;                     // number of sector images logged
+  char unused[SectorSize - 2 * sizeof(int)];
+};
+
+// The following class defines the metadata journal.  Metadata sectors
+// are read and written through it rather than through synchDisk, so
+// that reads see writes which have not been committed yet.
+
+class Journal
+{
+public:
+  Journal();  // Start with nothing pending
+  ~Journal(); // Pending writes are lost
+
+  void Format();  // Write an empty journal on a new disk
+  void Recover(); // Replay a committed journal left by a crash
+
+  void ReadSector(int sector, char *data);  // Read a metadata sector
+  void WriteSector(int sector, char *data); // Buffer a metadata write
+  void Forget(int sector); // Drop the pending write of a freed sector
+
+  void Commit();        // Make all pending writes durable
+  int NumPending();     // Number of sectors waiting to be committed
+  int Room();           // Number of sectors that can still be written
+
+private:
+  int numPending;                        // sectors buffered
+  int home[JournalCapacity];             // where each one belongs
+  char image[JournalCapacity][SectorSize]; // newest contents of each
+
+  int Lookup(int sector); // Slot holding "sector", or -1
+  int ImageSector(int slot) // Where the image in "slot" is logged
+      { return JournalSector + 1 + JournalMapSectors + slot; }
+};
+
+#endif // JOURNAL_H
@@ -11,7 +11,10 @@
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-p <nachos file> -r <nachos file> -l -D -t -gt <size>
+//		-mkdir <nachos dir> -rmdir <nachos dir> -dt <number of files>
+//		-bench <file size> <number of files> -ck -fix
+//		-ct <number of readers>
 //              -n <network reliability> -e <network orderability>
 //              -m <machine id>
 //              -o <other machine id>
@@ -34,6 +37,17 @@
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system
 //    -t tests the performance of the Nachos file system
+//    -gt grows a file byte by byte to <size> bytes and checks it
+//    -mkdir creates a directory (Nachos names are paths: /dir/file)
+//    -rmdir removes an empty directory
+//    -dt tests directories with <number of files> files in one of them
+//    -bench times sequential and random reads and writes of a <file size>
+//	byte file, growing one, and creating, removing and looking up
+//	<number of files> small files
+//    -ck checks the file system for damaged files and lost sectors
+//    -fix checks the file system, and repairs what it finds
+//    -ct runs <number of readers> threads reading a file while another
+//	thread rewrites it, all creating and removing files (use -rs)
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -59,6 +73,9 @@
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
+extern void GrowTest(int size), DirTest(int numFiles);
+extern void Benchmark(int fileSize, int numFiles);
+extern void ConcurrentTest(int numReaders);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
 extern void SynchTest(void);
@@ -150,6 +167,50 @@ int main(int argc, char **argv)
 		{ // performance test
 			PerformanceTest();
 		}
+		else if (!strcmp(*argv, "-gt"))
+		{ // grow a file through every index level
+			ASSERT(argc > 1);
+			GrowTest(atoi(*(argv + 1)));
+			argCount = 2;
+		}
+		else if (!strcmp(*argv, "-mkdir"))
+		{ // make a Nachos directory
+			ASSERT(argc > 1);
+			fileSystem->Mkdir(*(argv + 1));
+			argCount = 2;
+		}
+		else if (!strcmp(*argv, "-rmdir"))
+		{ // remove a Nachos directory
+			ASSERT(argc > 1);
+			fileSystem->Rmdir(*(argv + 1));
+			argCount = 2;
+		}
+		else if (!strcmp(*argv, "-dt"))
+		{ // directory test
+			ASSERT(argc > 1);
+			DirTest(atoi(*(argv + 1)));
+			argCount = 2;
+		}
+		else if (!strcmp(*argv, "-bench"))
+		{ // file system benchmark
+			ASSERT(argc > 2);
+			Benchmark(atoi(*(argv + 1)), atoi(*(argv + 2)));
+			argCount = 3;
+		}
+		else if (!strcmp(*argv, "-ck"))
+		{ // check the file system
+			fileSystem->Check(FALSE);
+		}
+		else if (!strcmp(*argv, "-fix"))
+		{ // check and repair the file system
+			fileSystem->Check(TRUE);
+		}
+		else if (!strcmp(*argv, "-ct"))
+		{ // concurrent file access test
+			ASSERT(argc > 1);
+			ConcurrentTest(atoi(*(argv + 1)));
+			argCount = 2;
+		}
 #endif // FILESYS
 #ifdef NETWORK
 		if (!strcmp(*argv, "-o"))
@@ -164,6 +225,9 @@ int main(int argc, char **argv)
 #endif // NETWORK
 	}
 
+#ifdef FILESYS
+	fileSystem->Sync(); // commit what the commands above changed
+#endif
 	currentThread->Finish(); // NOTE: if the procedure "main"
 							 // returns, then the program "nachos"
 							 // will exit (as any other normal program
@@ -0,0 +1,157 @@
+// namecache.cc
+//	Routines to cache the results of path name lookups.
+//
+//	Lookups and hits are counted in "stats", and reported by
+//	Statistics::Print.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "namecache.h"
+
+//----------------------------------------------------------------------
+// NormalizePath
+// 	Copy "path" into "key" without leading, trailing or repeated '/',
+//	and return its hash.  Return FALSE in "*ok" if the result would
+//	not fit in MaxCachedPath characters.
+//----------------------------------------------------------------------
+
+static unsigned int
+NormalizePath(char *path, char *key, bool *ok)
+{
+    unsigned int h = 5381;
+    int len = 0;
+
+    *ok = TRUE;
+    for (; *path != '\0'; path++)
+    {
+        if (*path == '/' && (len == 0 || key[len - 1] == '/'))
+            continue; // leading or repeated '/'
+        if (len == MaxCachedPath)
+        {
+            *ok = FALSE;
+            return 0;
+        }
+        key[len++] = *path;
+    }
+    if (len > 0 && key[len - 1] == '/')
+        len--; // trailing '/'
+    key[len] = '\0';
+    for (int i = 0; i < len; i++)
+        h = h * 33 + (unsigned char)key[i];
+    return h;
+}
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize an empty cache.
+//----------------------------------------------------------------------
+
+NameCache::NameCache()
+{
+    for (int s = 0; s < NameCacheSets; s++)
+        for (int w = 0; w < NameCacheWays; w++)
+            table[s][w].valid = FALSE;
+    useCount = 0;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+}
+
+//----------------------------------------------------------------------
+// NameCache::Lookup
+// 	Look "path" up in the cache.  On a hit, set "*sector" to the file
+//	header it leads to (or -1 for a negative entry) and return TRUE.
+//----------------------------------------------------------------------
+
+bool NameCache::Lookup(char *path, int *sector)
+{
+    char key[MaxCachedPath + 1];
+    NameCacheEntry *entry;
+    unsigned int hash;
+    bool ok;
+
+    stats->numNameLookups++;
+    hash = NormalizePath(path, key, &ok);
+    if (!ok || (entry = Find(key, hash)) == NULL)
+        return FALSE;
+    stats->numNameHits++;
+    entry->lastUse = ++useCount;
+    *sector = entry->sector;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember that "path" leads to the file header at "sector" (or,
+//	if "sector" is -1, to nothing), replacing the least recently used
+//	entry of its set.
+//----------------------------------------------------------------------
+
+void NameCache::Enter(char *path, int sector)
+{
+    char key[MaxCachedPath + 1];
+    NameCacheEntry *entry, *set;
+    unsigned int hash;
+    bool ok;
+
+    hash = NormalizePath(path, key, &ok);
+    if (!ok)
+        return; // too long to cache
+    entry = Find(key, hash);
+    if (entry == NULL)
+    {
+        set = table[hash % NameCacheSets];
+        entry = &set[0];
+        for (int w = 0; w < NameCacheWays && entry->valid; w++)
+            if (!set[w].valid || set[w].lastUse < entry->lastUse)
+                entry = &set[w];
+        entry->valid = TRUE;
+        entry->hash = hash;
+        strcpy(entry->path, key);
+    }
+    entry->sector = sector;
+    entry->lastUse = ++useCount;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Invalidate
+// 	Forget whatever is cached about "path".
+//----------------------------------------------------------------------
+
+void NameCache::Invalidate(char *path)
+{
+    char key[MaxCachedPath + 1];
+    NameCacheEntry *entry;
+    unsigned int hash;
+    bool ok;
+
+    hash = NormalizePath(path, key, &ok);
+    if (ok && (entry = Find(key, hash)) != NULL)
+        entry->valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Find
+// 	Return the entry holding "key" (whose hash is "hash"), or NULL.
+//----------------------------------------------------------------------
+
+NameCacheEntry *
+NameCache::Find(char *key, unsigned int hash)
+{
+    NameCacheEntry *set = table[hash % NameCacheSets];
+
+    for (int w = 0; w < NameCacheWays; w++)
+        if (set[w].valid && set[w].hash == hash && !strcmp(set[w].path, key))
+            return &set[w];
+    return NULL;
+}
@@ -0,0 +1,62 @@
+// namecache.h
+//	Data structures for a cache of path name lookups (in UNIX terms,
+//	a "dentry cache").
+//
+//	FileSystem::Open has to walk a path one directory at a time.
+//	The cache remembers, for recently opened path names, the sector
+//	of the file header they lead to -- or that they lead nowhere (a
+//	"negative" entry), so that looking for a missing file again is
+//	just as cheap.
+//
+//	Path names are cached in a normal form (no leading, trailing or
+//	repeated '/'), so "/a/b" and "a//b" share an entry.  Any operation
+//	that changes what a path name refers to (Create, Remove, Mkdir,
+//	Rmdir) must invalidate it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef NAMECACHE_H
+#define NAMECACHE_H
+
+#include "utility.h"
+
+// The cache is set-associative: a path name hashes to one set, and is
+// looked for only among that set's ways.  Longer path names than
+// MaxCachedPath are simply not cached.
+#define NameCacheSets 32
+#define NameCacheWays 4
+#define MaxCachedPath 63
+
+class NameCacheEntry {
+  public:
+    bool valid;				// Does this entry hold a name?
+    int sector;				// Its file header, or -1 (negative)
+    unsigned int hash;			// Hash of the name, compared first
+    int lastUse;			// For LRU replacement within a set
+    char path[MaxCachedPath + 1];	// The name, in normal form
+};
+
+class NameCache {
+  public:
+    NameCache();			// Initialize an empty cache
+    ~NameCache();			// De-allocate the cache
+
+    bool Lookup(char *path, int *sector);
+					// If "path" is cached, set "sector"
+					// (-1 if it leads nowhere), return TRUE
+    void Enter(char *path, int sector);	// Remember what "path" leads to
+    void Invalidate(char *path);	// Forget "path"
+
+  private:
+    NameCacheEntry table[NameCacheSets][NameCacheWays];
+    int useCount;			// Ticks on every lookup, for LRU
+
+    NameCacheEntry *Find(char *key, unsigned int hash);
+					// Entry holding "key", or NULL
+};
+
+#endif // NAMECACHE_H
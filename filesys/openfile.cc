@@ -5,7 +5,10 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  The header is shared with every
+//	other OpenFile of the same file, through the inode table (cf.
+//	inodetable.h), and so is the readers/writers lock that makes each
+//	ReadAt and WriteAt atomic.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -14,34 +17,39 @@
 #include "copyright.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "inodetable.h"
 #include "system.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless another OpenFile already
+//	has it there.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 {
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = inodeTable->Get(sector);
+    hdr = inode->hdr;
     DEBUG('f',"文件长度:%d\n",hdr->FileLength());
     seekPosition = 0;
     this->secotr = sector;
-    this->freeMapFile=NULL;
+    journaled = FALSE;
+    nextRead = 0;
+    raWindow = 0;
+    raNext = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
-// 	Close a Nachos file, de-allocating any in-memory data structures.
+// 	Close a Nachos file, letting go of its shared file header.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    inodeTable->Put(inode);
 }
 
 //----------------------------------------------------------------------
@@ -63,11 +71,13 @@ void OpenFile::Seek(int position)
 //	Return the number of bytes actually written or read, and as a
 //	side effect, increment the current position within the file.
 //
-//	Implemented using the more primitive ReadAt/WriteAt.
+//	Implemented using the more primitive ReadAt/WriteAt.  ReadV and
+//	WriteV do the same for a scattered buffer.
 //
 //	"into" -- the buffer to contain the data to be read from disk
 //	"from" -- the buffer containing the data to be written to disk
 //	"numBytes" -- the number of bytes to transfer
+//	"iov", "count" -- the pieces of a scattered buffer
 //----------------------------------------------------------------------
 
 int OpenFile::Read(char *into, int numBytes)
@@ -84,6 +94,20 @@ int OpenFile::Write(char *into, int numBytes)
     return result;
 }
 
+int OpenFile::ReadV(IoVec *iov, int count)
+{
+    int result = ReadAtV(iov, count, seekPosition);
+    seekPosition += result;
+    return result;
+}
+
+int OpenFile::WriteV(IoVec *iov, int count)
+{
+    int result = WriteAtV(iov, count, seekPosition);
+    seekPosition += result;
+    return result;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -92,29 +116,79 @@ int OpenFile::Write(char *into, int numBytes)
 //
 //	There is no guarantee the request starts or ends on an even disk sector
 //	boundary; however the disk only knows how to read/write a whole disk
-//	sector at a time.  Thus:
+//	sector at a time.  Thus each sector of the request is handled on
+//	its own:
 //
+//	   A sector that is entirely part of the request is transferred
+//	   straight to or from the caller's buffer.
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   Only the part of a partial sector we are interested in is
+//	   copied, straight out of the buffer cache.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   A partial sector is first read in, then the new bytes are
+//	   copied in and the sector is written back.  But the sectors from
+//	   the one the file ends in onwards are delayed (cf. inodetable.h):
+//	   they are kept in memory, and new ones only get disk sectors once
+//	   a batch of them is written out.  So a run of small appends costs
+//	   about one write per sector, and growing the file's header only
+//	   happens once per batch.
 //
 //	"into" -- the buffer to contain the data to be read from disk
 //	"from" -- the buffer containing the data to be written to disk
 //	"numBytes" -- the number of bytes to transfer
 //	"position" -- the offset within the file of the first byte to be
 //			read/written
+//
+//	ReadAtV/WriteAtV transfer the "count" pieces of "iov" in turn,
+//	to or from consecutive bytes of the file, as one request; ReadAt
+//	and WriteAt are the one-piece case.
+//
+//	Both hold the file's lock throughout -- ReadAt only for reading,
+//	so readers of the same file don't wait for each other; DoReadAt
+//	and DoWriteAt are the unlocked parts.  Data sectors go through the
+//	buffer cache, and ReadAt reads ahead for sequential readers.
 //----------------------------------------------------------------------
 
 int OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    IoVec piece;
+
+    piece.base = into;
+    piece.length = numBytes;
+    return ReadAtV(&piece, 1, position);
+}
+
+int OpenFile::WriteAt(char *from, int numBytes, int position)
+{
+    IoVec piece;
+
+    piece.base = from;
+    piece.length = numBytes;
+    return WriteAtV(&piece, 1, position);
+}
+
+int OpenFile::ReadAtV(IoVec *iov, int count, int position)
+{
+    int result = 0, numRead;
+
+    inode->lock->AcquireRead();
+    for (int i = 0; i < count; i++)
+    {
+        numRead = DoReadAt(iov[i].base, iov[i].length, position + result);
+        result += numRead;
+        if (numRead < iov[i].length)
+            break; // the end of the file
+    }
+    if (result > 0 && !journaled)
+        ReadAhead(position, result);
+    inode->lock->ReleaseRead();
+    return result;
+}
+
+int OpenFile::DoReadAt(char *into, int numBytes, int position)
+{
+    int fileLength = inode->length;
+    int i, start, end, firstSector, lastSector;
 
     if ((numBytes <= 0) || (position >= fileLength))
         return 0; // check request
@@ -125,68 +199,303 @@ int OpenFile::ReadAt(char *into, int numBytes, int position)
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
     for (i = firstSector; i <= lastSector; i++)
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize),
-                              &buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete[] buf;
+    {
+        start = max(position, i * SectorSize);
+        end = min(position + numBytes, (i + 1) * SectorSize);
+        if (end - start == SectorSize)
+            ReadSector(i, &into[start - position]);
+        else // copy the part we want
+            ReadPart(i, start - i * SectorSize, &into[start - position],
+                     end - start);
+    }
     return numBytes;
 }
 
-int OpenFile::WriteAt(char *from, int numBytes, int position)
+int OpenFile::WriteAtV(IoVec *iov, int count, int position)
 {
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int fileLength;
+    int numBytes = 0;
 
-    if (numBytes <= 0)
+    for (int i = 0; i < count; i++)
+        numBytes += iov[i].length;
+    if (numBytes <= 0 || position < 0)
         return 0; // check request
-    if (position > fileLength || position < 0)
+
+    inode->lock->AcquireWrite();
+    fileLength = inode->length;
+    if (position > fileLength)
     {
         DEBUG('f', "Position %d can't > fileLength %d.\n", position, fileLength);
+        inode->lock->ReleaseWrite();
         return 0; // check request
     }
 
     if (position + numBytes > fileLength)
     {
-        //如果写入文件超出原本文件大小,则重新分配磁盘空间
-        hdr->addLength(numBytes, secotr,freeMapFile);
+        //如果写入文件超出原本文件大小,则只为超出的部分分配磁盘空间
+        //(普通文件先只预留空间,写回延迟数据时再分配)
+        if (journaled ? !fileSystem->ExtendFile(hdr, secotr, position + numBytes - fileLength)
+                      : !Reserve(position + numBytes))
+        {
+            inode->lock->ReleaseWrite();
+            return 0; // no room on disk
+        }
     }
 
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",
           numBytes, position, fileLength);
+    for (int i = 0, done = 0; i < count; i++)
+    {
+        if (iov[i].length > 0)
+            DoWriteAt(iov[i].base, iov[i].length, position + done, fileLength);
+        done += iov[i].length;
+    }
+    if (journaled && position + numBytes > fileLength)
+    {
+        inode->length = hdr->FileLength();
+        fileSystem->EndOp();
+    }
+    inode->lock->ReleaseWrite();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::DoWriteAt
+// 	Write "numBytes" bytes from "from" at "position", a sector at a
+//	time, with the file's lock held and room for the data set aside.
+//
+//	"oldLength" -- the length of the file before the whole request,
+//		which decides the sectors whose writing is delayed
+//----------------------------------------------------------------------
+
+void OpenFile::DoWriteAt(char *from, int numBytes, int position, int oldLength)
+{
+    int i, start, end, firstSector, lastSector;
+
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    for (i = firstSector; i <= lastSector; i++)
+    {
+        start = max(position, i * SectorSize);
+        end = min(position + numBytes, (i + 1) * SectorSize);
+        if (!journaled && (end >= oldLength ||
+                           (inode->firstDelayed >= 0 && i >= inode->firstDelayed)))
+            WriteDelayed(i, start - i * SectorSize, &from[start - position],
+                         end - start);
+        else if (end - start == SectorSize)
+            WriteSector(i, &from[start - position]);
+        else
+            WritePartial(i, start - i * SectorSize, &from[start - position],
+                         end - start);
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadSector/WriteSector
+// 	Read/write the "which"th sector of the file as a whole: from the
+//	file's delayed sectors if it is one of them, from the header if
+//	the file's data is kept there, otherwise through the journal (for
+//	metadata) or the buffer cache.  WriteSector is never asked to
+//	write a delayed sector.
+//
+//	Writing the data of an inline file writes its header, which is
+//	journaled like any other, so it counts as a file system operation.
+//----------------------------------------------------------------------
+
+void OpenFile::ReadSector(int which, char *into)
+{
+    int sector;
+
+    if (inode->firstDelayed >= 0 && which >= inode->firstDelayed)
+    {
+        bcopy(&inode->delayed[(which - inode->firstDelayed) * SectorSize],
+              into, SectorSize);
+        return;
+    }
+    if (hdr->IsInline())
+    {
+        ASSERT(which == 0);
+        hdr->ReadInline(into);
+        return;
+    }
+    sector = hdr->ByteToSector(which * SectorSize);
+    if (journaled)
+        journal->ReadSector(sector, into);
+    else
+        bufferCache->ReadSector(sector, into);
+}
 
-    buf = new char[numSectors * SectorSize];
+void OpenFile::WriteSector(int which, char *from)
+{
+    int sector;
 
-    firstAligned = (bool)(position == (firstSector * SectorSize));
-    lastAligned = (bool)((position + numBytes) == ((lastSector + 1) * SectorSize));
+    if (hdr->IsInline())
+    {
+        ASSERT(which == 0);
+        hdr->WriteInline(from);
+        fileSystem->WriteHeader(hdr, secotr);
+        fileSystem->EndOp();
+        return;
+    }
+    sector = hdr->ByteToSector(which * SectorSize);
+    if (journaled)
+        journal->WriteSector(sector, from);
+    else
+        bufferCache->WriteSector(sector, from);
+}
 
-    //read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize],
-               SectorSize, lastSector * SectorSize);
+//----------------------------------------------------------------------
+// OpenFile::ReadPart
+// 	Read "numBytes" bytes at offset "offset" within the "which"th
+//	sector of the file into "into".  Ordinary data comes straight out
+//	of the delayed sectors or the buffer cache; only an inline or
+//	journaled sector is read whole first.
+//----------------------------------------------------------------------
 
-    // copy in the bytes we want to change
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+void OpenFile::ReadPart(int which, int offset, char *into, int numBytes)
+{
+    char buf[SectorSize];
 
-    // write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize),
-                               &buf[(i - firstSector) * SectorSize]);
-    delete[] buf;
-    return numBytes;
+    if (inode->firstDelayed >= 0 && which >= inode->firstDelayed)
+        bcopy(&inode->delayed[(which - inode->firstDelayed) * SectorSize + offset],
+              into, numBytes);
+    else if (hdr->IsInline() || journaled)
+    {
+        ReadSector(which, buf);
+        bcopy(&buf[offset], into, numBytes);
+    }
+    else
+        bufferCache->ReadPart(hdr->ByteToSector(which * SectorSize), offset,
+                              into, numBytes);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WritePartial
+// 	Write "numBytes" bytes from "from" at offset "offset" within the
+//	"which"th sector of the file, a sector wholly inside the file: read
+//	it in, change it and write it back.
+//----------------------------------------------------------------------
+
+void OpenFile::WritePartial(int which, int offset, char *from, int numBytes)
+{
+    char buf[SectorSize];
+
+    ReadSector(which, buf);
+    bcopy(from, &buf[offset], numBytes);
+    WriteSector(which, buf);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteDelayed
+// 	Like WritePartial (but "numBytes" may be a whole sector), for a
+//	write that reaches the end of the file, or goes into a sector that
+//	is delayed already: the data goes into the file's delayed sectors
+//	(cf. inodetable.h), not to disk.  If they are full, they are
+//	written out first.  The file's length grows to cover the data.
+//
+//	Only the first sector to be delayed can hold file data that must
+//	be read in: any later one is past the end of the file.
+//----------------------------------------------------------------------
+
+void OpenFile::WriteDelayed(int which, int offset, char *from, int numBytes)
+{
+    int base = which * SectorSize;
+    int old = min(inode->length - base, SectorSize); // old data in it
+
+    if (inode->firstDelayed >= 0 && which - inode->firstDelayed >= DelayedSectors)
+        inodeTable->FlushDelayed(inode); // full: make room
+    if (inode->firstDelayed < 0)
+    {
+        if (old > 0 && (offset > 0 || offset + numBytes < old))
+            ReadSector(which, inode->delayed); // keep what we don't overwrite
+        else
+            bzero(inode->delayed, SectorSize); // nothing there worth reading
+        inode->firstDelayed = which;
+        inode->numDelayed = 1;
+    }
+    else if (which == inode->firstDelayed + inode->numDelayed)
+        bzero(&inode->delayed[inode->numDelayed++ * SectorSize], SectorSize);
+    ASSERT(which - inode->firstDelayed < inode->numDelayed);
+
+    bcopy(from, &inode->delayed[(which - inode->firstDelayed) * SectorSize + offset],
+          numBytes);
+    if (base + offset + numBytes > inode->length)
+        inode->length = base + offset + numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Reserve
+// 	Make sure enough free sectors are set aside to grow the file to
+//	"newLength" bytes when its delayed sectors are written.  Return
+//	FALSE if the disk (or the file) can't get that big.
+//
+//	Setting sectors aside may commit, which writes the delayed sectors
+//	and grows the file, so we check again when it has.
+//----------------------------------------------------------------------
+
+bool OpenFile::Reserve(int newLength)
+{
+    int needed, length;
+
+    if (divRoundUp(newLength, SectorSize) > MaxFileSectors)
+        return FALSE;
+    for (;;)
+    {
+        length = hdr->FileLength();
+        needed = FileHeader::SectorsFor(newLength) - FileHeader::SectorsFor(length);
+        if (needed <= inode->reserved)
+            return TRUE;
+        if (!fileSystem->Reserve(needed - inode->reserved))
+            return FALSE;
+        inode->reserved = needed;
+        if (hdr->FileLength() == length)
+            return TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Having just read "numBytes" at "position", decide whether this
+//	file is being read sequentially, and if so make sure the next
+//	raWindow sectors are on their way into the buffer cache.
+//
+//	The window starts small and doubles every time the reader gets
+//	halfway through what was read ahead, up to MaxReadAhead; a read
+//	anywhere but where the last one ended collapses it to nothing.
+//	The window belongs to this OpenFile, so other readers holding the
+//	file's lock at the same time don't disturb it.
+//----------------------------------------------------------------------
+
+void OpenFile::ReadAhead(int position, int numBytes)
+{
+    int next = divRoundUp(position + numBytes, SectorSize);
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize); // on disk
+    int count;
+    int *sectors;
+
+    if (position != nextRead)
+    { // a seek: stop reading ahead until the reads look sequential
+        nextRead = position + numBytes;
+        raWindow = 0;
+        raNext = 0;
+        return;
+    }
+    nextRead = position + numBytes;
+    if (raNext < next)
+        raNext = next; // the reader has caught up with us
+    if (raWindow > 0 && raNext - next > raWindow / 2)
+        return; // still plenty read ahead
+    raWindow = (raWindow == 0) ? MinReadAhead : min(2 * raWindow, MaxReadAhead);
+    count = min(next + raWindow, fileSectors) - raNext;
+    if (count <= 0)
+        return; // at the end of the file
+
+    sectors = new int[count];
+    hdr->ByteRangeToSectors(raNext * SectorSize, count * SectorSize, sectors);
+    bufferCache->ReadAhead(sectors, count);
+    raNext += count;
+    delete[] sectors;
 }
 
 //----------------------------------------------------------------------
@@ -196,9 +505,18 @@ int OpenFile::WriteAt(char *from, int numBytes, int position)
 
 int OpenFile::Length()
 {
-    return hdr->FileLength();
+    return inode->length;
 }
 
-void OpenFile::setFreeMap(OpenFile *file){
-    this->freeMapFile=file;
+//----------------------------------------------------------------------
+// OpenFile::SetJournaled
+// 	From now on, read and write the contents of this file through the
+//	metadata journal instead of going straight to the disk.  Used for
+//	the bitmap and directory files, so that their updates are committed
+//	together with the file headers they describe.
+//----------------------------------------------------------------------
+
+void OpenFile::SetJournaled()
+{
+    journaled = TRUE;
 }
@@ -23,6 +23,14 @@
 #include "copyright.h"
 #include "utility.h"
 
+// One piece of a scattered buffer.  The system calls read and write
+// a user buffer as the list of its pieces in physical memory (one per
+// page), so the data moves straight between the file and the frames.
+struct IoVec {
+    char *base;				// Start of the piece
+    int length;				// Bytes in it
+};
+
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
 					// See definitions listed under #else
@@ -50,6 +58,20 @@ class OpenFile {
 		currentOffset += numWritten;
 		return numWritten;
 		}
+    int ReadV(IoVec *iov, int count) {
+		int numRead = 0, n;
+		for (int i = 0; i < count; i++) {
+		    numRead += (n = Read(iov[i].base, iov[i].length));
+		    if (n < iov[i].length) break;
+		}
+		return numRead;
+		}
+    int WriteV(IoVec *iov, int count) {
+		int numWritten = 0;
+		for (int i = 0; i < count; i++)
+		    numWritten += Write(iov[i].base, iov[i].length);
+		return numWritten;
+		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
     
@@ -60,6 +82,7 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Inode;
 
 class OpenFile {
   public:
@@ -81,18 +104,52 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    int ReadV(IoVec *iov, int count);	// Read/Write, into/from the
+    int WriteV(IoVec *iov, int count);	// "count" pieces of "iov" in turn,
+					// as one atomic operation
+    int ReadAtV(IoVec *iov, int count, int position);
+    int WriteAtV(IoVec *iov, int count, int position);
+					// ReadAt/WriteAt, likewise
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
 
-		void setFreeMap(OpenFile *file);
+    void SetJournaled();		// Read/write the contents through
+					// the metadata journal (for the
+					// bitmap and directory files)
     
   private:
-    FileHeader *hdr;			// Header for this file
+    Inode *inode;			// Shared entry for this file in
+					// the inode table
+    FileHeader *hdr;			// Header for this file (inode->hdr)
 		int secotr;//记录头部的扇区
     int seekPosition;			// Current position within the file
-		OpenFile* freeMapFile;
+    bool journaled;			// Contents are file system metadata?
+    int nextRead;			// Where a sequential read would start
+    int raWindow;			// Sectors to keep read ahead (0 if
+					// the reads aren't sequential)
+    int raNext;				// First sector not yet read ahead
+
+    int DoReadAt(char *into, int numBytes, int position);
+					// ReadAt, with the lock already held
+    void DoWriteAt(char *from, int numBytes, int position, int oldLength);
+					// WriteAt, with the lock held and the
+					// space set aside
+    void ReadSector(int which, char *into);
+    void WriteSector(int which, char *from);
+					// Read/write the "which"th sector
+					// of the file, all of it
+    void ReadPart(int which, int offset, char *into, int numBytes);
+    void WritePartial(int which, int offset, char *from, int numBytes);
+					// Read/write part of a sector
+    void WriteDelayed(int which, int offset, char *from, int numBytes);
+					// Write into the delayed sectors
+    bool Reserve(int newLength);	// Set space aside to grow the file
+    void ReadAhead(int position, int numBytes);
+					// After a read, queue the sectors a
+					// sequential reader will want next
 };
 
 #endif // FILESYS
@@ -45,10 +45,16 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The disk size can be changed by compiling with -DNumTracks=<n> (the
+// default is 32 tracks, 128KB); an existing DISK file must then be
+// re-formatted with -f.
 
 #define SectorSize 128                           // number of bytes per disk sector，每扇区字节数
 #define SectorsPerTrack 32                       // number of sectors per disk track ，每磁道扇区数
+#ifndef NumTracks                                // may be overridden with -DNumTracks=...
 #define NumTracks 32                             // number of tracks per disk，每个磁盘的磁道数
+#endif                                           // to simulate a larger disk
 #define NumSectors (SectorsPerTrack * NumTracks) //扇区总数=每磁道扇区数*磁道数
                                                  // total # of sectors per disk
 
@@ -120,6 +120,21 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register，写寄存器
 
+    bool CopyIn(int virtAddr, char *into, int numBytes);
+    bool CopyOut(char *from, int virtAddr, int numBytes);
+				// Copy a buffer between user virtual memory
+				// and the kernel, a page at a time.  Return
+				// FALSE if an address isn't mapped (no
+				// exception is raised).
+    int CopyInString(int virtAddr, char *into, int maxBytes);
+				// Copy a null-terminated user string; return
+				// its length, or -1 if it faults or
+				// doesn't fit
+    bool KernelTranslate(int virtAddr, int *physAddr, bool writing);
+				// Translate a user address for the kernel
+				// to use, bringing the page in if it is
+				// only allocated on first touch
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
@@ -22,6 +22,8 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numNameLookups = numNameHits = 0;
+    numBufferReads = numBufferHits = numReadAheads = 0;
 }
 
 //----------------------------------------------------------------------
@@ -41,4 +43,12 @@ Statistics::Print()
     printf("Paging: faults %d\n", numPageFaults);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+#ifdef FILESYS
+    printf("Name cache: lookups %d, hits %d (%d%%)\n", numNameLookups,
+	numNameHits, numNameLookups > 0 ? 100 * numNameHits / numNameLookups : 0);
+    printf("Buffer cache: reads %d, hits %d (%d%%), read ahead %d\n",
+	numBufferReads, numBufferHits,
+	numBufferReads > 0 ? 100 * numBufferHits / numBufferReads : 0,
+	numReadAheads);
+#endif
 }
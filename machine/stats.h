@@ -35,6 +35,13 @@ class Statistics {
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numNameLookups;		// number of path names looked up in the
+				// file system's name cache
+    int numNameHits;		// number of those found in the cache
+    int numBufferReads;		// number of data sectors read through
+				// the buffer cache
+    int numBufferHits;		// number of those found in the cache
+    int numReadAheads;		// number of sectors queued for read-ahead
 
     Statistics(); 		// initialize everything to zero
 
@@ -450,6 +450,21 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// HostMicroseconds
+// 	Return the UNIX wall clock time, in microseconds.  Only the
+//	difference between two calls means anything.
+//----------------------------------------------------------------------
+
+double
+HostMicroseconds()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
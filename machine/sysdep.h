@@ -44,6 +44,10 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Real (host) time elapsed since some fixed point, in microseconds;
+// for timing Nachos itself, as opposed to simulated time
+extern double HostMicroseconds();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
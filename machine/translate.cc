@@ -171,6 +171,118 @@ bool Machine::WriteMem(int addr, int size, int value)
 	return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::CopyIn
+//	Copy "numBytes" bytes of virtual memory at "virtAddr" into the
+//	kernel buffer "into".  Unlike ReadMem, each page is translated
+//	once and copied with a single bcopy, since within a page the
+//	bytes are contiguous in mainMemory.
+//
+//	Returns FALSE, without raising an exception, if some page of the
+//	range isn't mapped; the kernel then fails the system call instead
+//	of trapping again from inside it.
+//----------------------------------------------------------------------
+
+bool Machine::CopyIn(int virtAddr, char *into, int numBytes)
+{
+	int physAddr, chunk;
+
+	DEBUG('a', "Copying in VA 0x%x, size %d\n", virtAddr, numBytes);
+	while (numBytes > 0)
+	{
+		if (!KernelTranslate(virtAddr, &physAddr, FALSE))
+			return FALSE;
+		chunk = min(numBytes, PageSize - (int)((unsigned)virtAddr % PageSize));
+		bcopy(&mainMemory[physAddr], into, chunk);
+		virtAddr += chunk;
+		into += chunk;
+		numBytes -= chunk;
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyOut
+//	Copy "numBytes" bytes from the kernel buffer "from" into virtual
+//	memory at "virtAddr", a page at a time.  Returns FALSE if some page
+//	isn't mapped or is read-only; the pages before it have been written.
+//----------------------------------------------------------------------
+
+bool Machine::CopyOut(char *from, int virtAddr, int numBytes)
+{
+	int physAddr, chunk;
+
+	DEBUG('a', "Copying out VA 0x%x, size %d\n", virtAddr, numBytes);
+	while (numBytes > 0)
+	{
+		if (!KernelTranslate(virtAddr, &physAddr, TRUE))
+			return FALSE;
+		chunk = min(numBytes, PageSize - (int)((unsigned)virtAddr % PageSize));
+		bcopy(from, &mainMemory[physAddr], chunk);
+		virtAddr += chunk;
+		from += chunk;
+		numBytes -= chunk;
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyInString
+//	Copy the null-terminated string at "virtAddr" into "into", which
+//	holds "maxBytes" bytes.  Each page is translated once and scanned
+//	for the terminator in place.
+//
+//	Returns the length of the string copied, or -1 if it runs into an
+//	unmapped page, or is too long for "into" (a name cut short would
+//	name something else).
+//----------------------------------------------------------------------
+
+int Machine::CopyInString(int virtAddr, char *into, int maxBytes)
+{
+	int physAddr, chunk, length = 0;
+	char *end = NULL;
+
+	ASSERT(maxBytes > 0);
+	while (length < maxBytes) // the terminator must be in "into" too
+	{
+		if (!KernelTranslate(virtAddr, &physAddr, FALSE))
+			return -1;
+		chunk = min(maxBytes - length,
+					PageSize - (int)((unsigned)virtAddr % PageSize));
+		end = (char *)memchr(&mainMemory[physAddr], '\0', chunk);
+		if (end != NULL)
+			chunk = end - &mainMemory[physAddr];
+		bcopy(&mainMemory[physAddr], into + length, chunk);
+		length += chunk;
+		virtAddr += chunk;
+		if (end != NULL)
+			break;
+	}
+	if (end == NULL)
+		return -1; // no terminator within maxBytes
+	into[length] = '\0';
+	return length;
+}
+
+//----------------------------------------------------------------------
+// Machine::KernelTranslate
+//	Translate "virtAddr" for the kernel to read or write the user's
+//	memory itself.  A page of the current address space that doesn't
+//	have a frame yet, because it only gets one when first touched, is
+//	brought in first, as a user access would (cf. AddrSpace::Fault).
+//	Returns FALSE if the address can't be used.
+//----------------------------------------------------------------------
+
+bool Machine::KernelTranslate(int virtAddr, int *physAddr, bool writing)
+{
+	ExceptionType exception = Translate(virtAddr, physAddr, 1, writing);
+
+	if (exception == PageFaultException && currentThread->space != NULL &&
+		currentThread->space->Fault(virtAddr))
+		exception = Translate(virtAddr, physAddr, 1, writing);
+	return exception == NoException;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using
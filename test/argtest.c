@@ -0,0 +1,40 @@
+/* argtest.c
+ *	Test program for Exec with arguments: they reach the new program's
+ *	main() as argc and argv, and Exec fails if there are too many, or
+ *	they don't fit, or can't be read.  Runs exechild, which must be in
+ *	the file system too.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+char *argv[MaxExecArgs + 1];
+char longArg[MaxArgSize + 1];
+
+int
+main()
+{
+    int i;
+
+    argv[0] = "exechild";
+    argv[1] = "args";
+    argv[2] = "xyz";
+    Check(Join(Exec("exechild", 3, argv)) == 300 + 4 + 3,
+	  "Exec with arguments");
+    Check(Join(Exec("exechild", 2, argv)) == 200 + 4,
+	  "Exec with fewer arguments than given");
+    Check(Exec("exechild", 2, (char **) BadAddr) == -1,
+	  "Exec of bad arguments");
+    for (i = 0; i <= MaxExecArgs; i++)
+	argv[i] = "args";
+    Check(Exec("exechild", MaxExecArgs + 1, argv) == -1,
+	  "Exec of too many arguments");
+    for (i = 0; i < MaxArgSize; i++)	/* fails, not cut short */
+	longArg[i] = 'x';
+    argv[1] = longArg;
+    Check(Exec("exechild", 2, argv) == -1, "Exec of arguments that don't fit");
+    Done("argtest");
+}
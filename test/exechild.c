@@ -0,0 +1,78 @@
+/* exechild.c
+ *	Program that the Exec and Join tests run.  What it does depends on
+ *	its arguments:
+ *
+ *	    (none)		exit with status 7
+ *	    args ...		exit with 100 * argc, plus the length of
+ *				each argument but the program's name
+ *	    address		store to an address outside the program
+ *	    heap		store to a heap page given back with Sbrk
+ *	    thread		fork a thread that does as "address", while
+ *				this one keeps running
+ *
+ *	The last three are killed, and killtest checks that Join returns
+ *	FaultStatus plus the exception they caused.  It is kept apart
+ *	from testlib, and small: it is in memory at the same time as the
+ *	test running it.
+ */
+
+#include "syscall.h"
+
+#define PageSize 128	/* as in machine.h */
+
+int
+Length(char *s)
+{
+    int n = 0;
+
+    while (s[n] != '\0')
+	n++;
+    return n;
+}
+
+int
+Equal(char *a, char *b)
+{
+    while (*a != '\0' && *a == *b) {
+	a++;
+	b++;
+    }
+    return *a == *b;
+}
+
+void
+BadStore()
+{
+    *(int *) 0x7ffff000 = 1;	/* AddressErrorException */
+}
+
+int
+main(int argc, char **argv)
+{
+    char *p;
+    int i, status;
+
+    if (argc <= 1)
+	Exit(7);
+    if (Equal(argv[1], "args")) {
+	status = 100 * argc;
+	for (i = 1; i < argc; i++)
+	    status += Length(argv[i]);
+	Exit(status);
+    }
+    if (Equal(argv[1], "address"))
+	BadStore();
+    if (Equal(argv[1], "heap")) {
+	p = Sbrk(PageSize);
+	p[0] = 1;
+	Sbrk(-PageSize);
+	p[0] = 2;			/* PageFaultException */
+    }
+    if (Equal(argv[1], "thread")) {
+	if (Fork(BadStore) == -1)
+	    BadStore();			/* no memory for it: fault here */
+	for (;;)
+	    Yield();			/* until killed with the other */
+    }
+    Exit(0);
+}
@@ -0,0 +1,61 @@
+/* filetest.c
+ *	Test program for the file system calls Create, Open, Read, Write
+ *	and Close, and for the errors they return.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).  Leaves the file it
+ *	creates behind.
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+#define Size	200	/* spans pages, so several frames */
+#define NameSize 200	/* longer than a file name can be */
+
+char out[Size], in[Size];
+
+/* Create, Open, Read, Write and Close, each one on its own. */
+void
+TestFiles()
+{
+    char name[NameSize];
+    OpenFileId fd;
+    int i;
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'a' + i % 26;
+    Check(Create("ft.dat") == 0, "Create");
+    Check(Open("nosuch.dat") == -1, "Open of a missing file");
+    fd = Open("ft.dat");
+    Check(fd > ConsoleOutput, "Open");
+    Check(Write(out, Size, fd) == Size, "Write");
+    Close(fd);
+    Check(Read(in, Size, fd) == -1, "Read of a closed file");
+    Check(Write(out, Size, fd) == -1, "Write to a closed file");
+    Check(Write(out, 1, ConsoleInput) == -1, "Write to ConsoleInput");
+
+    fd = Open("ft.dat");
+    Clear(in, Size);
+    Check(Read(in, Size, fd) == Size && Same(in, out, Size), "Read back");
+    Check(Read(in, Size, fd) == 0, "Read at the end of the file");
+    Check(Read(in, -1, fd) == -1, "Read of a negative size");
+    Check(Read(BadAddr, 10, fd) == -1, "Read into a bad buffer");
+    Check(Write(BadAddr, 10, fd) == -1, "Write from a bad buffer");
+    Check(Read(in, 0x7fffffff, fd) == -1, "Read of a huge size");
+    Check(Write(out, 0x7fffffff, fd) == -1, "Write of a huge size");
+    Close(fd);
+
+    for (i = 0; i < NameSize - 1; i++)	/* too long: fails, not cut short */
+	name[i] = 'n';
+    name[NameSize - 1] = '\0';
+    Check(Open(name) == -1, "Open of a name that is too long");
+    Check(Open(BadAddr) == -1, "Open of a bad name");
+}
+
+int
+main()
+{
+    TestFiles();
+    Done("filetest");
+}
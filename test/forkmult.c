@@ -0,0 +1,71 @@
+/* forkmult.c
+ *    Test program for Fork: matrix multiplication, with the rows of
+ *    the result shared out between threads of the one program.
+ *
+ *    The matrices are global, so all the threads see them.  Worker
+ *    "w" computes every Workers-th row starting at row "w"; the main
+ *    thread waits for each to be done, and then checks every element.
+ *    If a worker can't be forked (memory is short: each thread needs
+ *    a stack of its own), the main thread does its rows itself.
+ *
+ *    Prints a line if the result is wrong, and exits with the number
+ *    of wrong elements (0 if it is right); the program's status is
+ *    that of its last thread to exit, so the main thread goes last.
+ */
+
+#include "syscall.h"
+
+#define Dim	6	/* small: the stacks take most of memory */
+#define Workers	2
+
+int A[Dim][Dim];
+int B[Dim][Dim];
+int C[Dim][Dim];
+int done[Workers];	/* set by each worker when its rows are done */
+
+void
+Multiply(int w)
+{
+    int i, j, k;
+
+    for (i = w; i < Dim; i += Workers)
+	for (j = 0; j < Dim; j++)
+	    for (k = 0; k < Dim; k++)
+		C[i][j] += A[i][k] * B[k][j];
+    done[w] = 1;
+}
+
+void Worker0() { Multiply(0); }
+void Worker1() { Multiply(1); }
+
+int
+main()
+{
+    int i, j, wrong = 0;
+
+    for (i = 0; i < Dim; i++)		/* first initialize the matrices */
+	for (j = 0; j < Dim; j++) {
+	     A[i][j] = i;
+	     B[i][j] = j;
+	     C[i][j] = 0;
+	}
+
+    if (Fork(Worker0) == -1)		/* then multiply them together */
+	Multiply(0);
+    if (Fork(Worker1) == -1)
+	Multiply(1);
+    for (i = 0; i < Workers; i++)	/* wait for the workers */
+	while (!done[i])
+	    Yield();
+    Yield();		/* let them exit, so that ours is the last Exit */
+
+    for (i = 0; i < Dim; i++)		/* C[i][j] = sum of i * j */
+	for (j = 0; j < Dim; j++)
+	    if (C[i][j] != Dim * i * j)
+		wrong++;
+    if (wrong != 0)
+	Write("forkmult FAILED: wrong result\n", 30, ConsoleOutput);
+    else
+	Write("forkmult passed\n", 16, ConsoleOutput);
+    Exit(wrong);
+}
@@ -0,0 +1,35 @@
+/* jointest.c
+ *	Test program for Exec and Join: Join returns the exit status of a
+ *	program, once; Exec of a file that is missing, or isn't a program,
+ *	fails instead of stopping Nachos.  Runs exechild, which must be in
+ *	the file system too.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).  Leaves the file it
+ *	creates behind.
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+int
+main()
+{
+    SpaceId pid;
+    OpenFileId fd;
+
+    pid = Exec("exechild", 0, 0);
+    Check(pid != -1, "Exec");
+    Check(Join(pid) == 7, "Join returns the exit status");
+    Check(Join(pid) == -1, "Join of a joined program");
+    Check(Join(-1) == -1 && Join(1000) == -1, "Join of a bad id");
+
+    Check(Exec("nosuch", 0, 0) == -1, "Exec of a missing file");
+    Create("notprog");
+    fd = Open("notprog");
+    Write("not a program", 13, fd);
+    Close(fd);
+    Check(Exec("notprog", 0, 0) == -1, "Exec of a file that isn't NOFF");
+    Check(Exec(BadAddr, 0, 0) == -1, "Exec of a bad name");
+    Done("jointest");
+}
@@ -0,0 +1,38 @@
+/* killtest.c
+ *	Test program for killing a program that causes an exception: it
+ *	ends, with every thread it has, and Join returns FaultStatus plus
+ *	the exception, while Nachos and the rest keep going.  Runs
+ *	exechild, which must be in the file system too.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+#define PageFaultException	2	/* as in machine.h */
+#define AddressErrorException	5
+
+char *argv[2];
+
+/* Run exechild doing "what", and return its status. */
+int
+Run(char *what)
+{
+    argv[0] = "exechild";
+    argv[1] = what;
+    return Join(Exec("exechild", 2, argv));
+}
+
+int
+main()
+{
+    Check(Run("address") == FaultStatus + AddressErrorException,
+	  "kill on an address error");
+    Check(Run("heap") == FaultStatus + PageFaultException,
+	  "kill on a page given back");
+    Check(Run("thread") == FaultStatus + AddressErrorException,
+	  "kill of every thread");
+    Done("killtest");
+}
@@ -0,0 +1,62 @@
+/* mmaptest.c
+ *	Test program for Mmap and Munmap, which map a file into the
+ *	address space: the file is read in as it is touched, changed
+ *	through memory, and written back when unmapped; and for the
+ *	errors they return.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).  Leaves the file it
+ *	creates behind.
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+#define Size	200	/* spans pages, so several frames */
+
+char out[Size], in[Size];
+
+/* Mmap and Munmap: change a file through memory. */
+void
+TestMmap()
+{
+    OpenFileId fd;
+    char *m;
+    int i, ok;
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'a' + i % 26;
+    Create("mt.dat");
+    fd = Open("mt.dat");
+    Check(Mmap(fd) == 0, "Mmap of an empty file");
+    Write(out, Size, fd);
+    m = Mmap(fd);
+    Check(m != 0, "Mmap");
+    Close(fd);			/* the mapping keeps the file open */
+    ok = 1;
+    for (i = 0; i < Size; i++)	/* read in from the file on first touch */
+	if (m[i] != out[i])
+	    ok = 0;
+    Check(ok, "mapped file contents");
+    for (i = 0; i < Size; i++)
+	m[i] = 'A' + i % 26;
+    fd = Open("mt.dat");
+    Check(Read(m, 10, fd) == 10 && m[0] == 'a', "Read into a mapped file");
+    Close(fd);
+    Check(Munmap(m) == 0, "Munmap");
+    Check(Munmap(m) == -1, "Munmap of an unmapped address");
+    Check(Munmap((char *) 4) == -1, "Munmap of a bad address");
+    Check(Mmap(1000) == 0, "Mmap of a bad descriptor");
+
+    fd = Open("mt.dat");	/* the changes were written back */
+    Check(Read(in, Size, fd) == Size && in[0] == 'a' && in[10] == 'K' &&
+	  in[Size - 1] == 'A' + (Size - 1) % 26, "changes written back");
+    Close(fd);
+}
+
+int
+main()
+{
+    TestMmap();
+    Done("mmaptest");
+}
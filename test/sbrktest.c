@@ -0,0 +1,46 @@
+/* sbrktest.c
+ *	Test program for Sbrk, which moves the end of the heap: heap pages
+ *	get memory, zeroed, on first touch, and give it back when the
+ *	heap shrinks; and for the errors it returns.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+/* Sbrk: grow the heap, use it, and give it back. */
+void
+TestSbrk()
+{
+    char *start = Sbrk(0), *p;
+    int i, ok;
+
+    Check(start != (char *) -1, "Sbrk(0)");
+    p = Sbrk(3 * PageSize);
+    Check(p == start, "Sbrk returns the old end");
+    Check(Sbrk(0) == start + 3 * PageSize, "Sbrk moves the end");
+    for (i = 0; i < 3 * PageSize; i++)	/* pages come in on first touch */
+	p[i] = i;
+    ok = 1;
+    for (i = 0; i < 3 * PageSize; i++)
+	if (p[i] != (char) i)
+	    ok = 0;
+    Check(ok, "heap memory");
+    Check(Read(p, 1, 1000) == -1, "Read into the heap of a bad file");
+    Check(Sbrk(-3 * PageSize) == start + 3 * PageSize, "Sbrk shrinks");
+    Check(Sbrk(-1) == (char *) -1, "Sbrk below the start of the heap");
+    Check(Sbrk(0x7fffffff) == (char *) -1, "Sbrk of a huge increment");
+    Check(Sbrk(0) == start, "failed Sbrk leaves the end alone");
+    p = Sbrk(PageSize);	/* the page comes back zeroed */
+    Check(p[0] == 0, "heap pages are zeroed");
+    Sbrk(-PageSize);
+}
+
+int
+main()
+{
+    TestSbrk();
+    Done("sbrktest");
+}
@@ -114,14 +114,73 @@ Close:
 	j	$31
 	.end Close
 
+	.globl ReadV
+	.ent	ReadV
+ReadV:
+	addiu $2,$0,SC_ReadV
+	syscall
+	j	$31
+	.end ReadV
+
+	.globl WriteV
+	.ent	WriteV
+WriteV:
+	addiu $2,$0,SC_WriteV
+	syscall
+	j	$31
+	.end WriteV
+
+	.globl Batch
+	.ent	Batch
+Batch:
+	addiu $2,$0,SC_Batch
+	syscall
+	j	$31
+	.end Batch
+
+	.globl Sbrk
+	.ent	Sbrk
+Sbrk:
+	addiu $2,$0,SC_Sbrk
+	syscall
+	j	$31
+	.end Sbrk
+
+	.globl Mmap
+	.ent	Mmap
+Mmap:
+	addiu $2,$0,SC_Mmap
+	syscall
+	j	$31
+	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:
+	addiu $2,$0,SC_Munmap
+	syscall
+	j	$31
+	.end Munmap
+
+/* Fork also passes the kernel, in r5, where the new thread goes when
+ * "func" returns: ForkReturn, which exits the thread.
+ */
 	.globl Fork
 	.ent	Fork
 Fork:
+	la	$5,ForkReturn
 	addiu $2,$0,SC_Fork
 	syscall
 	j	$31
 	.end Fork
 
+	.ent	ForkReturn
+ForkReturn:
+	move	$4,$0
+	addiu $2,$0,SC_Exit
+	syscall
+	.end ForkReturn
+
 	.globl Yield
 	.ent	Yield
 Yield:
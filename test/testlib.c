@@ -0,0 +1,66 @@
+/* testlib.c
+ *	Checks shared by the test programs (cf. testlib.h).  There is no
+ *	C library for user programs, so the little that is needed is
+ *	here, written out.
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+int failures = 0;
+
+int
+Length(char *s)
+{
+    int n = 0;
+
+    while (s[n] != '\0')
+	n++;
+    return n;
+}
+
+int
+Same(char *a, char *b, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+	if (a[i] != b[i])
+	    return 0;
+    return 1;
+}
+
+void
+Clear(char *a, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+	a[i] = 0;
+}
+
+/* Count a check that failed, printing what it was. */
+void
+Check(int ok, char *what)
+{
+    if (!ok) {
+	Write("FAILED: ", 8, ConsoleOutput);
+	Write(what, Length(what), ConsoleOutput);
+	Write("\n", 1, ConsoleOutput);
+	failures++;
+    }
+}
+
+/* Print whether test "name" passed, and exit with the number of
+ * checks that failed.
+ */
+void
+Done(char *name)
+{
+    Write(name, Length(name), ConsoleOutput);
+    if (failures == 0)
+	Write(" passed\n", 8, ConsoleOutput);
+    else
+	Write(" FAILED\n", 8, ConsoleOutput);
+    Exit(failures);
+}
@@ -0,0 +1,22 @@
+/* testlib.h
+ *	Checks shared by the test programs (filetest and the others
+ *	listed as "tests" in the Makefile), which are linked with
+ *	testlib.o.  A test program makes its checks with Check, then
+ *	calls Done, which exits with the number that failed.
+ */
+
+#ifndef TESTLIB_H
+#define TESTLIB_H
+
+#define PageSize 128	/* as in machine.h */
+#define BadAddr	((char *) 0x7ffff000)	/* not in the address space */
+
+extern int failures;	/* checks that have failed so far */
+
+int Length(char *s);			/* of a string */
+int Same(char *a, char *b, int size);	/* are the bytes equal? */
+void Clear(char *a, int size);		/* zero "size" bytes */
+void Check(int ok, char *what);		/* print "what" if !ok */
+void Done(char *name);			/* say if "name" passed, and exit */
+
+#endif /* TESTLIB_H */
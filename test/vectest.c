@@ -0,0 +1,97 @@
+/* vectest.c
+ *	Test program for the vectored file system calls ReadV and WriteV,
+ *	and for Batch, and for the errors they return.
+ *
+ *	Prints a line for each check that fails, and exits with the
+ *	number of them (0 if they all passed).  Leaves the files it
+ *	creates behind.
+ */
+
+#include "syscall.h"
+#include "testlib.h"
+
+#define Size	200	/* spans pages, so several frames */
+
+char out[Size], in[Size];
+
+/* ReadV and WriteV: a write from three buffers, read back into two. */
+void
+TestVectors()
+{
+    IoVector iov[MaxIoVectors + 1];
+    OpenFileId fd;
+    int i;
+
+    for (i = 0; i < Size; i++)
+	out[i] = 'a' + i % 26;
+    Create("vt.dat");
+    fd = Open("vt.dat");
+    iov[0].buffer = out;
+    iov[0].size = 10;
+    iov[1].buffer = out + 10;
+    iov[1].size = 0;
+    iov[2].buffer = out + 10;
+    iov[2].size = Size - 10;
+    Check(WriteV(iov, 3, fd) == Size, "WriteV");
+    Close(fd);
+
+    fd = Open("vt.dat");
+    Clear(in, Size);
+    iov[0].buffer = in;
+    iov[0].size = Size - 1;
+    iov[1].buffer = in + Size - 1;
+    iov[1].size = 1;
+    Check(ReadV(iov, 2, fd) == Size && Same(in, out, Size), "ReadV");
+    Check(ReadV(iov, MaxIoVectors + 1, fd) == -1, "ReadV of too many buffers");
+    Check(ReadV(iov, -1, fd) == -1, "ReadV of a negative count");
+    Check(ReadV((IoVector *) BadAddr, 1, fd) == -1, "ReadV of bad vectors");
+    iov[1].size = -1;
+    Check(ReadV(iov, 2, fd) == -1, "ReadV of a negative size");
+    iov[1].buffer = BadAddr;
+    iov[1].size = 1;
+    Check(ReadV(iov, 2, fd) == -1, "ReadV into a bad buffer");
+    Check(WriteV(iov, 2, fd) == -1, "WriteV from a bad buffer");
+    Close(fd);
+    Check(ReadV(iov, 1, fd) == -1, "ReadV of a closed file");
+}
+
+/* Batch: several calls in one trap, stopping at one it can't batch. */
+void
+TestBatch()
+{
+    SyscallDesc calls[3];
+    OpenFileId fd;
+
+    calls[0].code = SC_Create;
+    calls[0].arg[0] = (int) "vtb.dat";
+    calls[1].code = SC_Open;
+    calls[1].arg[0] = (int) "vtb.dat";
+    calls[2].code = SC_Halt;	/* not a file operation: not done */
+    Check(Batch(calls, 3) == 2, "Batch stopping at Halt");
+    Check(calls[0].result == 0, "Create in a batch");
+    fd = calls[1].result;
+    Check(fd > ConsoleOutput, "Open in a batch");
+
+    calls[0].code = SC_Write;
+    calls[0].arg[0] = (int) out;
+    calls[0].arg[1] = Size;
+    calls[0].arg[2] = fd;
+    calls[1].code = SC_Close;
+    calls[1].arg[0] = fd;
+    calls[2].code = SC_Close;	/* fails: closed already */
+    calls[2].arg[0] = fd;
+    Check(Batch(calls, 3) == 3, "Batch");
+    Check(calls[0].result == Size, "Write in a batch");
+    Check(calls[1].result == 0, "Close in a batch");
+    Check(calls[2].result == -1, "Close of a closed file");
+    Check(Batch(calls, MaxBatch + 1) == -1, "Batch of too many calls");
+    Check(Batch((SyscallDesc *) BadAddr, 1) == -1, "Batch of bad calls");
+}
+
+int
+main()
+{
+    TestVectors();
+    TestBatch();
+    Done("vectest");
+}
@@ -261,3 +261,120 @@ void Condition::Broadcast(Lock* conditionLock)
     } 
     (void) interrupt->SetLevel(oldLevel);
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a readers/writers lock, so that it can be used for
+//	synchronization.  Implemented in "monitor"-style, with a lock
+//	and two condition variables.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    readable = new Condition(debugName);
+    writable = new Condition(debugName);
+    numReaders = 0;
+    numWaitingWriters = 0;
+    writer = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	De-allocate the lock.  As with Lock, assume no one still holds it,
+//	or is waiting for it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    delete writable;
+    delete readable;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead/ReleaseRead
+//      Hold the lock for reading, once no thread is writing or waiting
+//      to write; let go of it again.  The last reader out lets a
+//      waiting writer in.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writer != NULL || numWaitingWriters > 0)
+        readable->Wait(lock);
+    numReaders++;
+    lock->Release();
+}
+
+void RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(numReaders > 0);
+    if (--numReaders == 0)
+        writable->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite/ReleaseWrite
+//      Hold the lock for writing, once nobody else holds it at all; let
+//      go of it again, handing it to the next writer if one is waiting,
+//      or else to every waiting reader.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    numWaitingWriters++;
+    while (writer != NULL || numReaders > 0)
+        writable->Wait(lock);
+    numWaitingWriters--;
+    writer = currentThread;
+    lock->Release();
+}
+
+void RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(writer == currentThread);
+    writer = NULL;
+    if (numWaitingWriters > 0)
+        writable->Signal(lock);
+    else
+        readable->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::TryAcquireWrite
+//      Hold the lock for writing if nobody holds it, and return TRUE;
+//      otherwise return FALSE at once, rather than wait.  For a thread
+//      that must not wait for the lock because of other locks it holds.
+//----------------------------------------------------------------------
+
+bool RWLock::TryAcquireWrite()
+{
+    bool result;
+
+    lock->Acquire();
+    result = (writer == NULL && numReaders == 0);
+    if (result)
+        writer = currentThread;
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// RWLock::isHeldByCurrentThread
+//      Return TRUE if the current thread holds the lock for writing.
+//----------------------------------------------------------------------
+
+bool RWLock::isHeldByCurrentThread()
+{
+    return writer == currentThread;
+}
@@ -5,7 +5,8 @@
 //	locks, and condition variables.  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	the first assignment.  A readers/writers lock, built out of a
+//	lock and condition variables, is defined here too.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -137,4 +138,47 @@ class Condition {
     Lock* lock;   // debugging aid:  used to check correctness of
                   // arguments to Wait, Signal and Broacast
 };
+
+// The following class defines a "readers/writers lock".  Any number of
+// threads may hold it for reading at once, or a single thread may hold
+// it for writing:
+//
+//	AcquireRead -- wait until no thread holds the lock for writing
+//		(or is waiting to), then hold it for reading
+//
+//	AcquireWrite -- wait until no thread holds the lock at all, then
+//		hold it for writing
+//
+// Writers go first: once a writer is waiting, new readers wait behind
+// it, so that a steady stream of readers can't keep it out forever.
+// As with locks, only the thread that acquired the lock for writing
+// may release it; and a thread must not acquire it again (for reading
+// or writing) while it holds it.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();			// share the lock with other readers
+    void ReleaseRead();
+    void AcquireWrite();		// have the lock to ourselves
+    void ReleaseWrite();
+    bool TryAcquireWrite();		// AcquireWrite, unless that would
+					// mean waiting: then return FALSE
+
+    bool isHeldByCurrentThread();	// true if the current thread
+					// holds this lock for writing
+
+  private:
+    char* name;				// for debugging
+    Lock *lock;				// protects the fields below
+    Condition *readable;		// signalled when readers may go in
+    Condition *writable;		// signalled when a writer may go in
+    int numReaders;			// threads holding it for reading
+    int numWaitingWriters;		// threads waiting in AcquireWrite
+    Thread *writer;			// thread holding it for writing,
+					// or NULL
+};
 #endif // SYNCH_H
@@ -25,10 +25,15 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+Journal     *journal;
+InodeTable  *inodeTable;
+BufferCache *bufferCache;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+ProcessTable *processTable;	// user processes, for Join
+SynchConsole *synchConsole;	// created on the first console Read/Write
 #endif
 
 #ifdef NETWORK
@@ -154,10 +159,16 @@ Initialize(int argc, char **argv)
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// 创建虚拟机
+    processTable = new ProcessTable;
+    synchConsole = NULL;		// the console polls for input, which
+					// would keep an idle Nachos running
 #endif
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
+    journal = new Journal;		// replayed or formatted by FileSystem
+    inodeTable = new InodeTable;
+    bufferCache = new BufferCache;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -182,6 +193,8 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete synchConsole;
+    delete processTable;
     delete machine;
 #endif
 
@@ -190,6 +203,9 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete bufferCache;
+    delete inodeTable;
+    delete journal;
     delete synchDisk;
 #endif
     
@@ -31,7 +31,12 @@ extern Timer *timer;				// the hardware alarm clock
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "synchconsole.h"
+#include "process.h"
 extern Machine* machine;	// user program memory and registers
+extern ProcessTable *processTable;	// PIDs, parents and exit status
+extern SynchConsole *synchConsole;	// ConsoleInput/ConsoleOutput of user
+					// programs; NULL until first used
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -41,7 +46,13 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "journal.h"
+#include "inodetable.h"
+#include "bufcache.h"
 extern SynchDisk   *synchDisk;
+extern Journal     *journal;		// metadata journal, see journal.h
+extern InodeTable  *inodeTable;		// headers of open files
+extern BufferCache *bufferCache;	// data sectors, see bufcache.h
 #endif
 
 #ifdef NETWORK
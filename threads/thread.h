@@ -128,6 +128,12 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+    int userStack;			// Its user stack in "space": -1 for
+					// the first thread, else the slot
+					// from AddrSpace::AddThread
+    void SetUserRegister(int num, int value) { userRegisters[num] = value; }
+					// Set up the user registers of a
+					// thread that hasn't run yet
 #endif
 };
 
@@ -19,6 +19,7 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "syscall.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -42,31 +43,142 @@ SwapHeader(NoffHeader *noffH)
     noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// NewPageTable, FreePageTable
+// 	Page tables of the last few address spaces to go away are kept
+//	here, so that the next ones, which are nearly always the same
+//	size, can have them instead of going back to the heap.  A table is
+//	reused only for exactly the size it had.
+//----------------------------------------------------------------------
+
+#define TableCacheSize 4 // Freed page tables kept for reuse
+
+static TranslationEntry *freeTables[TableCacheSize];
+static unsigned int freeTableSizes[TableCacheSize];
+static int nextVictim = 0; // Slot to give up when all are full
+
+static TranslationEntry *
+NewPageTable(unsigned int size)
+{
+    TranslationEntry *table;
+
+    for (int i = 0; i < TableCacheSize; i++)
+        if (freeTables[i] != NULL && freeTableSizes[i] == size)
+        {
+            table = freeTables[i];
+            freeTables[i] = NULL;
+            return table;
+        }
+    return new TranslationEntry[size];
+}
+
+static void
+FreePageTable(TranslationEntry *table, unsigned int size)
+{
+    int i;
+
+    for (i = 0; i < TableCacheSize; i++)
+        if (freeTables[i] == NULL)
+            break;
+    if (i == TableCacheSize)
+    {
+        i = nextVictim;
+        nextVictim = (nextVictim + 1) % TableCacheSize;
+        delete[] freeTables[i];
+    }
+    freeTables[i] = table;
+    freeTableSizes[i] = size;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::operator new, AddrSpace::operator delete
+// 	Likewise, the memory of the last few address spaces deleted is
+//	handed straight to the next ones created.
+//----------------------------------------------------------------------
+
+#define SpaceCacheSize 4 // Freed address spaces kept for reuse
+
+static void *freeSpaces[SpaceCacheSize];
+static int numFreeSpaces = 0;
+
+void *AddrSpace::operator new(size_t size)
+{
+    ASSERT(size == sizeof(AddrSpace));
+    if (numFreeSpaces > 0)
+        return freeSpaces[--numFreeSpaces];
+    return ::operator new(size);
+}
+
+void AddrSpace::operator delete(void *p)
+{
+    if (p == NULL)
+        return;
+    if (numFreeSpaces < SpaceCacheSize)
+        freeSpaces[numFreeSpaces++] = p;
+    else
+        ::operator delete(p);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace 地址空间
-// 	Create an address space to run a user program.
-//	Load the program from a file "executable", and set everything
+// 	Create an empty address space.  Init loads a program into it;
+//	if that fails, the address space can only be deleted.
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace()
+{
+    pageTable = NULL;
+    numPages = tableSize = 0;
+    numThreads = 0;
+    heapBase = brk = 0;
+    pid = -1;
+    argc = 0;
+    argvAddr = 0; // none, unless SetArguments is called
+    ioCount = numHeld = 0;
+    killed = FALSE;
+    killStatus = 0;
+    for (int i = 0; i < MaxMappings; i++)
+        mappings[i].ref = NULL;
+    for (int i = 0; i < MaxOpenFiles; i++)
+        fileTable[i] = NULL; // ConsoleInput and ConsoleOutput need no file
+    for (int i = 0; i < MaxUserThreads; i++)
+        pagesIn[i] = -1;
+    pageLock = new Lock("page in");
+    pageIn = new Condition("page in");
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Init
+// 	Load the program from a file "executable", and set everything
 //	up so that we can start executing user instructions.
 //
 //	Assumes that the object code file is in NOFF format.
 //
 //	First, set up the translation from program memory to physical
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	memory.  Each page gets a frame of its own; the frames need not
+//	be contiguous.
+//
+//	Return FALSE, with nothing loaded, if the file isn't a NOFF file
+//	(or its segments don't fit the address space), if there aren't
+//	enough free frames, or if there is no free PID.  These are
+//	mistakes of the program calling Exec, so they must not stop Nachos.
 //
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
 
-AddrSpace::AddrSpace(OpenFile *executable)
+bool AddrSpace::Init(OpenFile *executable)
 {
     NoffHeader noffH;
     unsigned int i, size;
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if (executable->ReadAt((char *)&noffH, sizeof(noffH), 0) != sizeof(noffH))
+        return FALSE;
     if ((noffH.noffMagic != NOFFMAGIC) && //将小端切换大端
         (WordToHost(noffH.noffMagic) == NOFFMAGIC))
         SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    if (noffH.noffMagic != NOFFMAGIC || noffH.code.size < 0 ||
+        noffH.initData.size < 0 || noffH.uninitData.size < 0)
+        return FALSE; // 不是可执行文件
 
     // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size + UserStackSize; // we need to increase the size
@@ -74,111 +186,184 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 
-    ASSERT(numPages <= NumPhysPages); // check we're not trying
-                                      // to run anything too big --
-                                      // at least until we have
-                                      // virtual memory
+    if (numPages > (unsigned)machine->freeFrame->NumClear() || // too big, at
+        !SegmentFits(noffH.code.virtualAddr, noffH.code.size) || // least until
+        !SegmentFits(noffH.initData.virtualAddr, noffH.initData.size)) // we
+        return FALSE;                                    // have virtual memory
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n",
           numPages, size);
     // first, set up the translation
-    pageTable = new TranslationEntry[numPages]; //新建页表
-    for (i = 0; i < numPages; i++)
+    tableSize = numPages + (MaxUserThreads - 1) * StackPages;
+    pageTable = NewPageTable(tableSize); //新建页表
+    for (i = 0; i < tableSize; i++)
     {
         pageTable[i].virtualPage = i; // for now, virtual page # = phys page #
-        pageTable[i].physicalPage = machine->freeFrame->Find();
-        ASSERT(pageTable[i].physicalPage != -1);
-        pageTable[i].valid = TRUE;
+        pageTable[i].physicalPage = -1;
+        pageTable[i].valid = FALSE; // other threads' stacks: not yet
         pageTable[i].use = FALSE;
         pageTable[i].dirty = FALSE;
         pageTable[i].readOnly = FALSE; // if the code segment was entirely on
                                        // a separate page, we could set its
                                        // pages to be read-only
     }
-    pid = machine->threadMap->Find();
-    // zero out the entire address space, to zero the unitialized data segment
-    // and the stack segment
-    bzero(machine->mainMemory + pageTable[0].physicalPage * PageSize, size);
+    for (i = 0; i < numPages; i++)
+    {
+        pageTable[i].physicalPage = machine->freeFrame->Find();
+        if (pageTable[i].physicalPage == -1)
+            return FALSE; // taken meanwhile; the destructor frees the rest
+        pageTable[i].valid = TRUE;
+        // zero out the page, to zero the unitialized data segment
+        // and the stack segment; the frames need not be contiguous
+        bzero(machine->mainMemory + pageTable[i].physicalPage * PageSize,
+              PageSize);
+    }
+    heapBase = brk = tableSize * PageSize;
 
     // then, copy in the code and data segments into memory读入代码段，数据段
-    //以下代码假设页表在物理上是连续的
     if (noffH.code.size > 0)
     {
         DEBUG('a', "Initializing code segment, at 0x%x, size %d\n",
               noffH.code.virtualAddr, noffH.code.size);
-        if (noffH.code.size <= PageSize)
-        { //仅需一页
-            executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr % PageSize + pageTable[noffH.code.virtualAddr / PageSize].physicalPage * PageSize]),
-                               noffH.code.size, noffH.code.inFileAddr);
-        }
-        else
-        {                                                          //需要多页
-            int codePages = divRoundUp(noffH.code.size, PageSize); //code段需要的页数
-            //第一页
-            int hasRead = 0; //已经读入的字节数
-            int firstPage = noffH.code.virtualAddr / PageSize;
-            executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr % PageSize + pageTable[firstPage].physicalPage * PageSize]),
-                               PageSize - noffH.code.virtualAddr % PageSize, noffH.code.inFileAddr);
-            hasRead += PageSize - noffH.code.virtualAddr % PageSize;
-            //中间页
-            for (int i = firstPage + 1; i < firstPage + codePages - 1; i++)
-            {
-                executable->ReadAt(&(machine->mainMemory[pageTable[i].physicalPage * PageSize]),
-                                   PageSize, noffH.code.inFileAddr + hasRead);
-                hasRead += PageSize;
-            }
-            //最后一页
-            executable->ReadAt(&(machine->mainMemory[pageTable[firstPage + codePages - 1].physicalPage * PageSize]),
-                               noffH.code.size - hasRead, noffH.code.inFileAddr + hasRead);
-        }
-        // executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr + pageTable[0].physicalPage * PageSize]),
-        //                    noffH.code.size, noffH.code.inFileAddr);
+        if (!LoadSegment(executable, noffH.code.virtualAddr,
+                         noffH.code.size, noffH.code.inFileAddr))
+            return FALSE;
     }
     if (noffH.initData.size > 0)
     {
         DEBUG('a', "Initializing data segment, at 0x%x, size %d\n",
               noffH.initData.virtualAddr, noffH.initData.size);
-        if (noffH.initData.size <= PageSize)
-        { //仅需一页
-            executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr % PageSize + pageTable[noffH.initData.virtualAddr / PageSize].physicalPage * PageSize]),
-                               noffH.initData.size, noffH.initData.inFileAddr);
-        }
-        else
-        {                                                          //需要多页
-            int dataPages = divRoundUp(noffH.initData.size, PageSize); //initData段需要的页数
-            //第一页
-            int hasRead = 0; //已经读入的字节数
-            int firstPage = noffH.initData.virtualAddr / PageSize;
-            executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr % PageSize + pageTable[firstPage].physicalPage * PageSize]),
-                               PageSize - noffH.initData.virtualAddr % PageSize, noffH.code.inFileAddr);
-            hasRead += PageSize - noffH.initData.virtualAddr % PageSize;
-            //中间页
-            for (int i = firstPage + 1; i < firstPage + dataPages - 1; i++)
-            {
-                executable->ReadAt(&(machine->mainMemory[pageTable[i].physicalPage * PageSize]),
-                                   PageSize, noffH.initData.inFileAddr + hasRead);
-                hasRead += PageSize;
-            }
-            //最后一页
-            executable->ReadAt(&(machine->mainMemory[pageTable[firstPage + dataPages - 1].physicalPage * PageSize]),
-                               noffH.initData.size - hasRead, noffH.initData.inFileAddr + hasRead);
-        }
-        // executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr + pageTable[0].physicalPage * PageSize]),
-        //                    noffH.initData.size, noffH.initData.inFileAddr);
+        if (!LoadSegment(executable, noffH.initData.virtualAddr,
+                         noffH.initData.size, noffH.initData.inFileAddr))
+            return FALSE;
     }
+
+    // the PID last, so that a process that never ran needs no Exit
+    pid = processTable->Add(currentThread->space != NULL ? // 父进程号
+                                currentThread->space->getPid() : NoParent);
+    if (pid == -1)
+        return FALSE; // 进程表已满
+    numThreads = 1;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SegmentFits
+// 	Return TRUE if a segment of "size" bytes at "virtAddr" lies within
+//	the program's pages.
+//----------------------------------------------------------------------
+
+bool AddrSpace::SegmentFits(int virtAddr, int size)
+{
+    return size == 0 ||
+           (virtAddr >= 0 && virtAddr + size <= (int)(numPages * PageSize));
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadSegment
+// 	Read the "size" bytes at "inFileAddr" in "executable" into the
+//	address space at "virtAddr", a page (that is, a frame) at a time.
+//	Return FALSE if the file is too short.
+//----------------------------------------------------------------------
+
+bool AddrSpace::LoadSegment(OpenFile *executable, int virtAddr, int size,
+                            int inFileAddr)
+{
+    int offset, chunk;
+
+    while (size > 0)
+    {
+        offset = virtAddr % PageSize;
+        chunk = min(size, PageSize - offset);
+        if (executable->ReadAt(&machine->mainMemory[pageTable[virtAddr / PageSize].physicalPage * PageSize + offset],
+                               chunk, inFileAddr) != chunk)
+            return FALSE;
+        virtAddr += chunk;
+        inFileAddr += chunk;
+        size -= chunk;
+    }
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, unmapping the files the program left
+//	mapped and closing those it left open.  The PID stays taken until
+//	the process table frees it, once the process has been joined.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-    machine->threadMap->Clear(pid);
-    for (int i = 0; i < numPages; i++)
-        machine->freeFrame->Clear(pageTable[i].physicalPage);
-    delete[] pageTable;
+    for (int m = 0; m < MaxMappings; m++)
+        if (mappings[m].ref != NULL)
+            Unmap(mappings[m].start); // writing back what changed
+    for (int fd = 0; fd < MaxOpenFiles; fd++)
+        if (fileTable[fd] != NULL)
+            DropFile(fileTable[fd]); // no thread is left to use it
+    delete pageIn;
+    delete pageLock;
+    if (pageTable == NULL)
+        return; // Init never got that far
+    ASSERT(ioCount == 0); // every thread has left the kernel
+    for (unsigned int i = 0; i < tableSize; i++)
+        if (pageTable[i].valid)
+            machine->freeFrame->Clear(pageTable[i].physicalPage);
+    FreePageTable(pageTable, tableSize);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SetArguments
+// 	Pass "count" arguments to the program's main().  "args" holds the
+//	strings one after another, "size" bytes in all counting their
+//	terminators.  They are copied to the top of the stack in one go,
+//	with the argv array (ending in a NULL) just below them; the stack
+//	pointer starts below that.
+//----------------------------------------------------------------------
+
+void AddrSpace::SetArguments(int count, char *args, int size)
+{
+    int argv[MaxExecArgs + 1];
+    int pointers = (count + 1) * sizeof(int);
+    int strings = divRoundUp(size, sizeof(int)) * sizeof(int);
+    int offset = 0;
+
+    ASSERT(count <= MaxExecArgs && pointers + strings < UserStackSize);
+    argc = count;
+    argvAddr = numPages * PageSize - strings - pointers;
+    for (int i = 0; i < count; i++)
+    {
+        argv[i] = WordToMachine(argvAddr + pointers + offset);
+        offset += strlen(args + offset) + 1;
+    }
+    argv[count] = 0;
+    CopyOut(argvAddr, (char *)argv, pointers);
+    CopyOut(argvAddr + pointers, args, size); // the stack is already zero
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOut
+// 	Copy "size" bytes from "from" to "virtAddr" in this address space,
+//	a page at a time through its own page table; the pages must have
+//	frames.
+//----------------------------------------------------------------------
+
+void AddrSpace::CopyOut(int virtAddr, char *from, int size)
+{
+    unsigned int vpn;
+    int offset, chunk;
+
+    while (size > 0)
+    {
+        vpn = (unsigned)virtAddr / PageSize;
+        offset = (unsigned)virtAddr % PageSize;
+        chunk = min(size, PageSize - offset);
+        ASSERT(vpn < tableSize && pageTable[vpn].valid);
+        bcopy(from, &machine->mainMemory[pageTable[vpn].physicalPage * PageSize + offset],
+              chunk);
+        virtAddr += chunk;
+        from += chunk;
+        size -= chunk;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -205,11 +390,404 @@ void AddrSpace::InitRegisters()
     // of branch delay possibility
     machine->WriteRegister(NextPCReg, 4);
 
+    // main(argc, argv): __start leaves these alone for it
+    machine->WriteRegister(4, argc);
+    machine->WriteRegister(5, argvAddr);
+
     // Set the stack register to the end of the address space, where we
-    // allocated the stack; but subtract off a bit, to make sure we don't
-    // accidentally reference off the end!
-    machine->WriteRegister(StackReg, numPages * PageSize - 16);
-    DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
+    // allocated the stack, or below the arguments; but subtract off a bit,
+    // to make sure we don't accidentally reference off the end!
+    int stackTop = (argvAddr != 0) ? argvAddr : numPages * PageSize;
+    machine->WriteRegister(StackReg, stackTop - 16);
+    DEBUG('a', "Initializing stack register to %d\n", stackTop - 16);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddThread
+// 	Set up a user stack for another thread of this address space, in
+//	the first free stack slot above the program.  Return the slot, or
+//	-1 if the space already has MaxUserThreads threads or there aren't
+//	enough free frames.
+//----------------------------------------------------------------------
+
+int AddrSpace::AddThread()
+{
+    for (int slot = 0; slot < MaxUserThreads - 1; slot++)
+    {
+        int first = numPages + slot * StackPages;
+        if (pageTable[first].valid)
+            continue; // in use
+        if (machine->freeFrame->NumClear() < StackPages)
+            return -1;
+        for (int i = first; i < first + StackPages; i++)
+        {
+            pageTable[i].physicalPage = machine->freeFrame->Find();
+            bzero(machine->mainMemory + pageTable[i].physicalPage * PageSize,
+                  PageSize);
+            pageTable[i].valid = TRUE;
+            pageTable[i].use = FALSE;
+            pageTable[i].dirty = FALSE;
+        }
+        numThreads++;
+        return slot;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StackTop
+// 	Return the initial stack pointer of a thread running on the stack
+//	in "slot" (-1 for the first thread's), a little below the end of
+//	the stack as in InitRegisters.
+//----------------------------------------------------------------------
+
+int AddrSpace::StackTop(int slot)
+{
+    return (numPages + (slot + 1) * StackPages) * PageSize - 16;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveThread
+// 	A thread of this address space has exited: free the stack in
+//	"slot" (the first thread's, -1, is part of the program and stays).
+//	Return TRUE if no thread is left, so the process is done.
+//----------------------------------------------------------------------
+
+bool AddrSpace::RemoveThread(int slot)
+{
+    if (slot >= 0)
+    {
+        int first = numPages + slot * StackPages;
+        ReleasePages(first, first + StackPages); // unless Kill did
+    }
+    return --numThreads == 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Kill
+// 	The program caused an exception, and must go: give back all its
+//	memory at once, writing back its mapped files.  With no valid page
+//	left, each of its threads faults at its next user instruction, and
+//	Fault no longer brings pages in, so the thread is terminated (with
+//	"status") then.  The address space itself, with its open files, is
+//	deleted when the last thread is gone.
+//
+//	Threads blocked in a Read or Write into their frames carry on
+//	until it is done; those frames are only freed then (cf.
+//	ReleasePages).  Everything below the mapped files -- program,
+//	stacks, heap -- is taken away before the writes back block, so
+//	that the other threads stop running right away.
+//----------------------------------------------------------------------
+
+void AddrSpace::Kill(int status)
+{
+    killed = TRUE;
+    killStatus = status;
+    ReleasePages(0, min((int)tableSize, heapBase / PageSize + MaxHeapPages));
+    for (int m = 0; m < MaxMappings; m++)
+        if (mappings[m].ref != NULL)
+            Unmap(mappings[m].start);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Grow (or, if "increment" is negative, shrink) the heap by
+//	"increment" bytes, and return where it used to end.  Return -1 if
+//	it would shrink below its start or grow past MaxHeapPages.
+//
+//	Growing only extends the page table, with invalid entries: a page
+//	gets a frame when the program first touches it (cf. Fault).  A
+//	page left wholly above the new end gives its frame back, once no
+//	Read or Write of another thread may still be using it.
+//----------------------------------------------------------------------
+
+int AddrSpace::Sbrk(int increment)
+{
+    int oldBrk = brk, newBrk = brk + increment;
+    unsigned int newSize = divRoundUp(newBrk, PageSize);
+
+    if (increment > MaxHeapPages * PageSize || newBrk < heapBase ||
+        newSize - heapBase / PageSize > MaxHeapPages)
+        return -1;
+    DEBUG('a', "Moving the break from 0x%x to 0x%x\n", oldBrk, newBrk);
+    GrowTable(newSize);
+    ReleasePages(newSize, divRoundUp(oldBrk, PageSize));
+    brk = newBrk;
+    return oldBrk;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GrowTable
+// 	Make the page table "newSize" entries long, if it is shorter; the
+//	new entries are invalid.
+//----------------------------------------------------------------------
+
+void AddrSpace::GrowTable(unsigned int newSize)
+{
+    TranslationEntry *table;
+
+    if (newSize <= tableSize)
+        return;
+    table = NewPageTable(newSize);
+    bcopy(pageTable, table, tableSize * sizeof(TranslationEntry));
+    for (unsigned int i = tableSize; i < newSize; i++)
+    {
+        table[i].virtualPage = i;
+        table[i].physicalPage = -1;
+        table[i].valid = FALSE;
+        table[i].use = FALSE;
+        table[i].dirty = FALSE;
+        table[i].readOnly = FALSE;
+    }
+    FreePageTable(pageTable, tableSize);
+    pageTable = table;
+    tableSize = newSize;
+    if (currentThread->space == this)
+        RestoreState(); // the machine still has the old table
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReleasePages
+// 	Give back the frames of the valid pages from "first" up to (not
+//	including) "last", leaving them invalid.  While a system call of
+//	some thread is reading or writing frames directly (cf. BeginIO),
+//	the frames are only held, and freed once it is done: otherwise
+//	the transfer could land in a page of another program.
+//----------------------------------------------------------------------
+
+void AddrSpace::ReleasePages(int first, int last)
+{
+    for (int i = first; i < last; i++)
+        if (pageTable[i].valid)
+        {
+            if (ioCount > 0)
+                heldFrames[numHeld++] = pageTable[i].physicalPage;
+            else
+                machine->freeFrame->Clear(pageTable[i].physicalPage);
+            pageTable[i].valid = FALSE;
+        }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::BeginIO, AddrSpace::EndIO
+// 	Bracket a transfer between a file and the frames of this address
+//	space that goes straight to mainMemory (cf. UserPieces), and may
+//	block.  Until the last such transfer is over, frames the program
+//	gives up are held rather than freed (cf. ReleasePages).
+//----------------------------------------------------------------------
+
+void AddrSpace::BeginIO()
+{
+    ioCount++;
+}
+
+void AddrSpace::EndIO()
+{
+    ASSERT(ioCount > 0);
+    if (--ioCount > 0)
+        return;
+    for (int i = 0; i < numHeld; i++)
+        machine->freeFrame->Clear(heldFrames[i]);
+    numHeld = 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Fault
+// 	The page holding "virtAddr" isn't valid.  If it is a page of the
+//	heap, or of a mapped file, which only get memory when first used,
+//	give it a frame -- zeroed, or filled from the file -- and return
+//	TRUE: the access can be tried again.
+//	Return FALSE if "virtAddr" isn't in the address space, or there
+//	is no free frame, or the program has been killed.
+//
+//	Reading the file blocks, and meanwhile other threads of the
+//	program run.  The page is marked as being read in (cf. pagesIn),
+//	so that a thread faulting on it too waits for it rather than
+//	giving it a second frame.  The file is held, so that Munmap can't
+//	close it under the read, and once the page is in, the mapping is
+//	looked up again: if it is gone, or the program has been killed,
+//	the frame is given back instead.
+//----------------------------------------------------------------------
+
+bool AddrSpace::Fault(int virtAddr)
+{
+    unsigned int vpn = (unsigned)virtAddr / PageSize;
+    Mapping *map;
+    FileRef *ref;
+    int frame, start, slot = 0;
+
+    pageLock->Acquire();
+    while (Reading(vpn))
+        pageIn->Wait(pageLock); // 另一个线程正在调入该页
+    if (killed || vpn >= tableSize || pageTable[vpn].valid)
+    {
+        pageLock->Release();
+        return !killed && vpn < tableSize; // valid: it was just brought in
+    }
+    map = FindMapping(virtAddr);
+    if ((map == NULL && (virtAddr < heapBase || virtAddr >= brk)) ||
+        (frame = machine->freeFrame->Find()) == -1)
+    {
+        pageLock->Release();
+        return FALSE;
+    }
+    DEBUG('a', "Page %d gets frame %d\n", vpn, frame);
+    bzero(machine->mainMemory + frame * PageSize, PageSize);
+    if (map != NULL)
+    { // read the page of the file in
+        ref = map->ref;
+        start = map->start;
+        ref->users++;
+        while (pagesIn[slot] != -1)
+            slot++; // a thread reads one page at a time
+        pagesIn[slot] = vpn;
+        pageLock->Release();
+        ref->file->ReadAt(machine->mainMemory + frame * PageSize, PageSize,
+                          vpn * PageSize - start);
+        pageLock->Acquire();
+        pagesIn[slot] = -1;
+        pageIn->Broadcast(pageLock);
+        map = FindMapping(virtAddr);
+        if (killed || map == NULL || map->ref != ref || map->start != start)
+        { // unmapped, or killed, while the page was read
+            machine->freeFrame->Clear(frame);
+            pageLock->Release();
+            DropFile(ref);
+            return FALSE;
+        }
+        DropFile(ref); // the mapping still holds it
+    }
+    pageTable[vpn].physicalPage = frame;
+    pageTable[vpn].valid = TRUE;
+    pageTable[vpn].use = FALSE;
+    pageTable[vpn].dirty = FALSE;
+    pageLock->Release();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindMapping
+// 	Return the mapping that "virtAddr" is in, or NULL if none.
+//----------------------------------------------------------------------
+
+Mapping *AddrSpace::FindMapping(int virtAddr)
+{
+    for (int m = 0; m < MaxMappings; m++)
+        if (mappings[m].ref != NULL && virtAddr >= mappings[m].start &&
+            virtAddr < mappings[m].start + mappings[m].length)
+            return &mappings[m];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Reading
+// 	Return TRUE if Fault is reading page "vpn" in from a file.
+//----------------------------------------------------------------------
+
+bool AddrSpace::Reading(unsigned int vpn)
+{
+    for (int i = 0; i < MaxUserThreads; i++)
+        if (pagesIn[i] == (int)vpn)
+            return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Map
+// 	Map the file open as "fd" into the address space, in the first
+//	gap big enough for it above the largest heap, and return the
+//	address where it starts.  Nothing is read yet: each page is read
+//	in from the file when first touched (cf. Fault).  Return 0 if "fd"
+//	isn't an open file, the file is empty, or MaxMappings files are
+//	mapped already.
+//
+//	The mapping holds on to the file (cf. HoldFile), so it stays open
+//	even if "fd" is closed.
+//----------------------------------------------------------------------
+
+int AddrSpace::Map(int fd)
+{
+    FileRef *ref = HoldFile(fd);
+    Mapping *map = NULL;
+    int start, length;
+    bool moved;
+
+    if (ref == NULL)
+        return 0;
+    for (int m = 0; m < MaxMappings; m++)
+        if (mappings[m].ref == NULL)
+            map = &mappings[m];
+    if (map == NULL || (length = ref->file->Length()) == 0)
+    {
+        DropFile(ref);
+        return 0;
+    }
+    start = heapBase + MaxHeapPages * PageSize;
+    do
+    { // first fit: move past every mapping in the way
+        moved = FALSE;
+        for (int m = 0; m < MaxMappings; m++)
+            if (mappings[m].ref != NULL &&
+                start < mappings[m].start + divRoundUp(mappings[m].length, PageSize) * PageSize &&
+                mappings[m].start < start + length)
+            {
+                start = mappings[m].start + divRoundUp(mappings[m].length, PageSize) * PageSize;
+                moved = TRUE;
+            }
+    } while (moved);
+    GrowTable(divRoundUp(start + length, PageSize));
+    map->start = start;
+    map->length = length;
+    map->ref = ref;
+    DEBUG('a', "Mapping file %d, %d bytes, at 0x%x\n", fd, length, start);
+    return start;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Unmap the file mapped at "addr": write the pages that were changed
+//	back to the file (not past its length when it was mapped), and
+//	free the frames.  Return FALSE if no file is mapped there.
+//
+//	The mapping and its pages are gone before anything is written, so
+//	that while the writes block, no other thread of the program can
+//	use them, or unmap them again; the frames are held until the
+//	writes are done (cf. BeginIO).
+//----------------------------------------------------------------------
+
+bool AddrSpace::Unmap(int addr)
+{
+    Mapping *map = NULL;
+    FileRef *ref;
+    int first, last, length, *dirty;
+
+    for (int m = 0; m < MaxMappings; m++)
+        if (mappings[m].ref != NULL && mappings[m].start == addr)
+            map = &mappings[m];
+    if (map == NULL)
+        return FALSE;
+    ref = map->ref;
+    length = map->length;
+    map->ref = NULL;
+    first = addr / PageSize;
+    last = divRoundUp(addr + length, PageSize);
+    dirty = new int[last - first]; // frame of each changed page
+    for (int i = first; i < last; i++)
+        dirty[i - first] = (pageTable[i].valid && pageTable[i].dirty)
+                               ? pageTable[i].physicalPage : -1;
+    BeginIO();
+    ReleasePages(first, last);
+    for (int i = first; i < last; i++)
+        if (dirty[i - first] != -1)
+        {
+            int offset = i * PageSize - addr;
+            ref->file->WriteAt(machine->mainMemory + dirty[i - first] * PageSize,
+                               min(PageSize, length - offset), offset);
+        }
+    EndIO();
+    delete[] dirty;
+    DropFile(ref); // closing it, if its descriptor was closed
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -217,14 +795,12 @@ void AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	For now, nothing!  The user registers belong to each thread, and
+//	are saved by Thread::SaveUserState.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState()
 {
-    //保存寄存器状态
-    for (int i = 0; i < NumTotalRegs; i++)
-        regState[i] = machine->ReadRegister(i);
 }
 
 //----------------------------------------------------------------------
@@ -237,10 +813,8 @@ void AddrSpace::SaveState()
 
 void AddrSpace::RestoreState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-        machine->WriteRegister(i, regState[i]);
     machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
+    machine->pageTableSize = tableSize;
 }
 
 void AddrSpace::Print()
@@ -249,9 +823,81 @@ void AddrSpace::Print()
     printf("===========================================\n");
     printf("\tVirtPage, \tPhysPage\n");
 
-    for (int i = 0; i < numPages; i++)
+    for (int i = 0; i < tableSize; i++)
     {
-        printf("\t%d, \t\t%d\n", pageTable[i].virtualPage, pageTable[i].physicalPage);
+        if (pageTable[i].valid)
+            printf("\t%d, \t\t%d\n", pageTable[i].virtualPage, pageTable[i].physicalPage);
     }
     printf("===========================================\n\n");
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter an open file in the descriptor table of this address space.
+//	Return its OpenFileId, or -1 if all the descriptors are in use.
+//	ConsoleInput and ConsoleOutput are never handed out.
+//
+//	"file" -- the open file; it is closed once the descriptor is, and
+//	nothing else is using it
+//----------------------------------------------------------------------
+
+int AddrSpace::AddFile(OpenFile *file)
+{
+    for (int fd = ConsoleOutput + 1; fd < MaxOpenFiles; fd++)
+        if (fileTable[fd] == NULL)
+        {
+            fileTable[fd] = new FileRef(file);
+            return fd;
+        }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::HoldFile
+// 	Return the file open as "fd", counting one more user of it, or
+//	NULL if "fd" is out of range, not open, or one of the console
+//	descriptors.  The file stays open, even if another thread closes
+//	"fd", until DropFile is called.  A system call holds the file for
+//	as long as it uses it, since reading or writing it may block.
+//----------------------------------------------------------------------
+
+FileRef *AddrSpace::HoldFile(int fd)
+{
+    if (fd < 0 || fd >= MaxOpenFiles || fileTable[fd] == NULL)
+        return NULL;
+    fileTable[fd]->users++;
+    return fileTable[fd];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DropFile
+// 	One user of "ref" is done with it; close the file if it was the
+//	last.
+//----------------------------------------------------------------------
+
+void AddrSpace::DropFile(FileRef *ref)
+{
+    ASSERT(ref->users > 0);
+    if (--ref->users == 0)
+    {
+        delete ref->file;
+        delete ref;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Close the file open as "fd", freeing the descriptor.  The OpenFile
+//	stays while the file is mapped, or a system call is using it.
+//	Return FALSE if there is no such file.
+//----------------------------------------------------------------------
+
+bool AddrSpace::RemoveFile(int fd)
+{
+    if (fd < 0 || fd >= MaxOpenFiles || fileTable[fd] == NULL)
+        return FALSE;
+    FileRef *ref = fileTable[fd];
+    fileTable[fd] = NULL;
+    DropFile(ref);
+    return TRUE;
+}
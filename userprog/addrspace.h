@@ -16,32 +16,137 @@
 #include "copyright.h"
 #include "filesys.h"
 
+class Lock;		  // synch.h includes thread.h, which includes this
+class Condition;
+
 #define UserStackSize 1024 // increase this as necessary!
+#define MaxOpenFiles 16	   // Open files per address space, counting
+						   // ConsoleInput and ConsoleOutput
+#define MaxUserThreads 4   // Threads per address space, counting
+						   // the first
+#define StackPages divRoundUp(UserStackSize, PageSize)
+#define MaxHeapPages NumPhysPages // Largest heap a program can ask for
+#define MaxMappings 4	   // Files mapped into an address space
+
+// A file opened by a program, which all the threads of its address
+// space share.  It counts its users -- the descriptor it is open as,
+// each mapping of it, and each system call in the middle of using it
+// -- and the OpenFile is deleted when the last one is done with it
+// (cf. AddrSpace::HoldFile, AddrSpace::DropFile).  A thread can then
+// Close a file while another is still reading it.
+class FileRef {
+  public:
+	FileRef(OpenFile *f) { file = f; users = 1; }
+	OpenFile *file;	  // The open file
+	int users;		  // Who still needs it
+};
+
+// A file mapped into an address space (cf. AddrSpace::Map).  Its pages
+// are read in from the file on first touch, and written back, if they
+// were changed, when it is unmapped.
+class Mapping {
+  public:
+	int start;		  // Virtual address of the first byte of the file
+	int length;		  // Bytes mapped: the file's length when mapped
+	FileRef *ref;	  // The file (NULL if this entry is unused)
+};
 
 class AddrSpace
 {
   public:
-	AddrSpace(OpenFile *executable); // Create an address space,
-									 // initializing it with the program
-									 // stored in the file "executable"
+	AddrSpace();					 // Create an empty address space
 	~AddrSpace();					 // De-allocate an address space
+	bool Init(OpenFile *executable); // Load the program stored in the
+									 // file "executable"; FALSE if it
+									 // can't be run
+
+	void *operator new(size_t size); // Reuse the memory of spaces
+	void operator delete(void *p);	 // recently deleted
 
+	void SetArguments(int count, char *args, int size);
+						  // Copy the "count" strings packed in
+						  // "args" onto the stack, for main()
 	void InitRegisters(); // Initialize user-level CPU registers,
 						  // before jumping to user code
 
+	int AddThread();			 // Give a new thread a stack of its
+								 // own; return its slot (-1 if none)
+	int StackTop(int slot);		 // Initial stack pointer for a slot
+	bool RemoveThread(int slot); // A thread has exited, freeing its
+								 // stack; TRUE if it was the last one
+
+	int Sbrk(int increment);	 // Move the end of the heap; return
+								 // the old end (-1 if it can't move)
+	void BeginIO();				 // A system call is about to use
+	void EndIO();				 // frames directly, and is done
+	bool Fault(int virtAddr);	 // Bring in a page that is only
+								 // allocated when first touched
+	int Map(int fd);			 // Map the file open as "fd"; return
+								 // its address (0 if it can't be)
+	bool Unmap(int addr);		 // Write back and unmap the file
+								 // mapped at "addr"
+	void Kill(int status);		 // Free the memory; each thread dies
+								 // at its next user instruction
+	bool Killed() { return killed; }
+	int KillStatus() { return killStatus; } // Exit status once killed
+
 	void SaveState();	// Save/restore address space-specific
 	void RestoreState(); // info on a context switch
 
 	void Print();
 	int getPid() { return pid; }
 
+	int AddFile(OpenFile *file);	// Give "file" a descriptor (-1 if
+									// the table is full)
+	FileRef *HoldFile(int fd);		// Use the file open as "fd" (NULL
+									// if none, or for the console)
+	void DropFile(FileRef *ref);	// Done using it
+	bool RemoveFile(int fd);		// Close "fd"; FALSE if it isn't open
+
   private:
 	TranslationEntry *pageTable; // Assume linear page table translation
 								 // for now!
 	unsigned int numPages;		 // Number of pages in the virtual
-								 // address space
+								 // address space (program and the
+								 // first thread's stack)
+	unsigned int tableSize;		 // Entries in the page table: the
+								 // pages above, then a stack slot
+								 // for each other thread
+	int numThreads;				 // Threads running in this space
+	int heapBase;				 // The heap starts here, above the
+								 // stack slots,
+	int brk;					 // and ends here (UNIX "break"); its
+								 // pages get frames on first touch
 	int pid;					 //进程号
-	int regState[NumTotalRegs];//保存寄存器组
+	int argc;					 // Arguments passed to main(),
+	int argvAddr;				 // and where their pointers are
+	int ioCount;				 // System calls using frames directly
+	int heldFrames[NumPhysPages]; // Frames given up while they were,
+	int numHeld;				 // freed when ioCount drops to 0
+	bool killed;				 // Has Kill been called?
+	int killStatus;				 // The status it was given
+	FileRef *fileTable[MaxOpenFiles];  // Open files, by OpenFileId;
+									   // 0 and 1 are the console
+	Mapping mappings[MaxMappings];	   // Mapped files, placed above
+									   // the largest heap
+	int pagesIn[MaxUserThreads]; // Pages Fault is reading in from
+								 // a file, one per thread (-1: none)
+	Lock *pageLock;				 // Protects pagesIn,
+	Condition *pageIn;			 // signalled when a page is in
+
+	void GrowTable(unsigned int newSize); // Add invalid page table
+										  // entries, up to "newSize"
+	void ReleasePages(int first, int last);
+								 // Free the frames of pages "first"
+								 // to "last" - 1 (after any I/O)
+	Mapping *FindMapping(int virtAddr); // Mapping holding "virtAddr"
+	bool Reading(unsigned int vpn); // Is Fault reading "vpn" in?
+	bool SegmentFits(int virtAddr, int size); // Within the program?
+	bool LoadSegment(OpenFile *executable, int virtAddr, int size,
+					 int inFileAddr); // Read a segment in
+	void CopyOut(int virtAddr, char *from, int size);
+								 // Copy into this space's memory,
+								 // which may not be the current one
 };
 
 #endif // ADDRSPACE_H
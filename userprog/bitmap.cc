@@ -2,6 +2,13 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	Searching and counting look at a whole word at a time (using the
+//	compiler's count-trailing-zeros and population-count builtins),
+//	rather than testing every bit.  We also keep the number of clear
+//	bits, and a summary bitmap with one bit per word that is set when
+//	the word is completely full, so Find does not have to walk over
+//	the allocated part of a large, nearly full disk.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -19,11 +26,22 @@
 
 BitMap::BitMap(int nitems) 
 { 
+    int numSummaryWords;
+
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
+    numChunks = divRoundUp(numWords * sizeof(unsigned), BitMapChunk);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    fullWords = new unsigned int[numSummaryWords];
+    dirtyChunks = new bool[numChunks];
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    for (int i = 0; i < numSummaryWords; i++) 
+        fullWords[i] = 0;
+    for (int i = 0; i < numChunks; i++) 
+        dirtyChunks[i] = TRUE;		// nothing on disk matches yet
+    numClear = numBits;
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +51,9 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] fullWords;
+    delete [] dirtyChunks;
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +67,14 @@ void
 BitMap::Mark(int which) 
 { 
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    int word = which / BitsInWord;
+    unsigned int bit = 1 << (which % BitsInWord);
+
+    if (!(map[word] & bit)) {
+	map[word] |= bit;
+	numClear--;
+	UpdateSummary(word);
+    }
 }
     
 //----------------------------------------------------------------------
@@ -61,7 +88,14 @@ void
 BitMap::Clear(int which) 
 {
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    int word = which / BitsInWord;
+    unsigned int bit = 1 << (which % BitsInWord);
+
+    if (map[word] & bit) {
+	map[word] &= ~bit;
+	numClear++;
+	UpdateSummary(word);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -94,11 +128,23 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    if (numClear == 0)
+	return -1;
+    for (int s = 0; s < divRoundUp(numWords, BitsInWord); s++) {
+	unsigned int notFull = ~fullWords[s];
+
+	for (; notFull != 0; notFull &= notFull - 1) {
+	    int word = s * BitsInWord + __builtin_ctz(notFull);
+	    if (word >= numWords)
+		break;
+	    unsigned int free = FreeBits(word);
+	    if (free != 0) {
+		int i = word * BitsInWord + __builtin_ctz(free);
+		Mark(i);
+		return i;
+	    }
 	}
+    }
     return -1;
 }
 
@@ -106,16 +152,120 @@ BitMap::Find()
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
 //	(In other words, how many bits are unallocated?)
+//	The count is maintained as bits are set and cleared.
 //----------------------------------------------------------------------
 
 int 
 BitMap::NumClear() 
 {
-    int count = 0;
+    return numClear;
+}
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+//----------------------------------------------------------------------
+// BitMap::FindContiguous
+// 	Find "count" consecutive clear bits, set them, and return the
+//	number of the first one.  The search starts at "hint" (typically
+//	just past the last block a file was given), and wraps around to
+//	the start of the map if nothing is found after it.
+//
+//	If there is no such run of clear bits, return -1.
+//----------------------------------------------------------------------
+
+int 
+BitMap::FindContiguous(int count, int hint) 
+{
+    int start;
+
+    if (count <= 0 || count > numClear)
+	return -1;
+    if (hint < 0 || hint >= numBits)
+	hint = 0;
+    start = FindRun(hint, numBits, count);
+    if (start == -1 && hint > 0)
+	start = FindRun(0, hint, count);
+    if (start == -1)
+	return -1;
+    for (int i = start; i < start + count; i++)
+	Mark(i);
+    return start;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Return the first bit in [from, to) that starts a run of "count"
+//	clear bits (the run itself may extend past "to"), or -1.
+//	Full words and empty words are stepped over a word at a time.
+//----------------------------------------------------------------------
+
+int 
+BitMap::FindRun(int from, int to, int count) 
+{
+    int run = 0, start = from;
+
+    for (int i = from; i < numBits && (i < to || run > 0); ) {
+	int word = i / BitsInWord;
+
+	if (i % BitsInWord == 0 && i + BitsInWord <= numBits) {
+	    if (fullWords[word / BitsInWord] & (1 << (word % BitsInWord))) {
+		run = 0;
+		i += BitsInWord;
+		continue;
+	    }
+	    if (map[word] == 0) {
+		if (run == 0)
+		    start = i;
+		run += BitsInWord;
+		i += BitsInWord;
+		if (run >= count)
+		    return start;
+		continue;
+	    }
+	}
+	if (Test(i))
+	    run = 0;
+	else {
+	    if (run == 0)
+		start = i;
+	    if (++run == count)
+		return start;
+	}
+	i++;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FreeBits
+// 	Return the clear bits of word "word" of the map as 1 bits,
+//	ignoring the unused bits at the end of the last word.
+//----------------------------------------------------------------------
+
+unsigned int
+BitMap::FreeBits(int word)
+{
+    unsigned int free = ~map[word];
+
+    if (word == numWords - 1 && numBits % BitsInWord != 0)
+	free &= (1 << (numBits % BitsInWord)) - 1;
+    return free;
+}
+
+//----------------------------------------------------------------------
+// BitMap::UpdateSummary
+// 	Record in the summary bitmap whether word "word" is now full,
+//	and remember that its piece of the map has to be written back.
+//----------------------------------------------------------------------
+
+void
+BitMap::UpdateSummary(int word)
+{
+    unsigned int bit = 1 << (word % BitsInWord);
+
+    if (FreeBits(word) == 0)
+	fullWords[word / BitsInWord] |= bit;
+    else
+	fullWords[word / BitsInWord] &= ~bit;
+    dirtyChunks[word * sizeof(unsigned) / BitMapChunk] = TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -149,11 +299,20 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    numClear = 0;
+    for (int i = 0; i < numWords; i++) {
+	numClear += __builtin_popcount(FreeBits(i));
+	UpdateSummary(i);
+    }
+    for (int i = 0; i < numChunks; i++)
+	dirtyChunks[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
 // BitMap::WriteBack
-// 	Store the contents of a bitmap to a Nachos file.
+// 	Store the contents of a bitmap to a Nachos file.  Only the pieces
+//	changed since the last FetchFrom/WriteBack are written, each run
+//	of consecutive changed pieces with a single WriteAt.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -161,5 +320,18 @@ BitMap::FetchFrom(OpenFile *file)
 void
 BitMap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int size = numWords * sizeof(unsigned);
+
+    for (int i = 0; i < numChunks; ) {
+	if (!dirtyChunks[i]) {
+	    i++;
+	    continue;
+	}
+	int first = i;
+	while (i < numChunks && dirtyChunks[i])
+	    dirtyChunks[i++] = FALSE;
+	int from = first * BitMapChunk;
+	int to = min(i * BitMapChunk, size);
+	file->WriteAt((char *)map + from, to - from, from);
+    }
 }
@@ -4,6 +4,10 @@
 //
 //	Represented as an array of unsigned integers, on which we do
 //	modulo arithmetic to find the bit we are interested in.
+//	Searches and counts work a whole word at a time, the number of
+//	clear bits is kept up to date, and a second, smaller bitmap
+//	(one bit per word, set when the word is full) lets searches skip
+//	over fully allocated regions of a large map.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -22,6 +26,8 @@
 // Definitions helpful for representing a bitmap as an array of integers
 #define BitsInByte 	8
 #define BitsInWord 	32
+#define BitMapChunk	128	// WriteBack granularity in bytes (one
+				// disk sector of the bitmap file)
 
 // The following class defines a "bitmap" -- an array of bits,
 // each of which can be independently set, cleared, and tested.
@@ -44,13 +50,17 @@ class BitMap {
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear();		// Return the number of clear bits
+    int FindContiguous(int count, int hint);
+				// Find "count" consecutive clear bits,
+				// preferably at or after "hint", set them
+				// and return the first; -1 if there are none
 
     void Print();		// Print contents of bitmap
     
     // These aren't needed until FILESYS, when we will need to read and 
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
-    void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteBack(OpenFile *file); 	// write changed contents to disk
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -59,6 +69,20 @@ class BitMap {
 					//  multiple of the number of bits in
 					//  a word)
     unsigned int *map;			// bit storage
+    int numClear;			// number of clear bits, kept up to
+					// date by Mark/Clear/FetchFrom
+    unsigned int *fullWords;		// bit "w" is set iff map[w] has no
+					// clear bits left (summary level)
+    int numChunks;			// BitMapChunk-sized pieces of map
+    bool *dirtyChunks;			// piece changed since the last
+					// FetchFrom/WriteBack?
+
+    unsigned int FreeBits(int word);	// clear bits of map[word], as 1s
+    void UpdateSummary(int word);	// recompute fullWords bit of "word"
+					// and mark its piece dirty
+    int FindRun(int from, int to, int count);
+					// first run of "count" clear bits
+					// starting in [from, to), or -1
 };
 
 #endif // BITMAP_H
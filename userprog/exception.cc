@@ -4,18 +4,21 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  We support Halt, Exec, Join, Exit, Fork and
+//	Yield, the file operations Create, Open, Read, Write, Close, ReadV
+//	and WriteV, Batch, which performs several file operations in one
+//	trap, Sbrk, which grows the heap, and Mmap and Munmap.
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
-//	etc.
+//	etc.  A page fault on a page of the heap or of a mapped file that
+//	hasn't been touched yet is handled by bringing the page in.
 //
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
-// Everything else core dumps.
+// Any other exception, or an unknown system call, kills the program
+// that caused it; the rest of the system goes on.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -27,6 +30,532 @@
 
 extern void StartProcess(int spaceId);
 void AdvancePC();
+
+//----------------------------------------------------------------------
+// StartUserThread
+// 	Run a thread created by the Fork system call.  Its user registers
+//	were set up by Fork; load them, and jump to user code.
+//----------------------------------------------------------------------
+
+static void
+StartUserThread(_int arg)
+{
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE); // the thread leaves through Exit, or is killed
+}
+
+//----------------------------------------------------------------------
+// ExitThread
+// 	The current thread leaves its address space with "status".  If it
+//	was the last thread there, the program is over: delete the address
+//	space, freeing its memory, writing back its mapped files and
+//	closing its files, then tell the process table, waking up a parent
+//	waiting in Join.  In that order, the parent finds the files as the
+//	program left them.  The file system commits then, at the end of
+//	the program, not of every thread.  The status of a killed program
+//	is the one it was killed with.
+//----------------------------------------------------------------------
+
+static void
+ExitThread(int status)
+{
+    AddrSpace *space = currentThread->space;
+    int pid = space->getPid();
+
+    currentThread->space = NULL;
+    if (space->Killed())
+        status = space->KillStatus();
+    if (space->RemoveThread(currentThread->userStack))
+    { // 最后一个线程退出，进程结束
+        delete space; // 写回映射的文件，关闭程序打开的文件
+#ifdef FILESYS
+        fileSystem->Sync(); // 进程结束时提交文件系统的修改
+#endif
+        processTable->Exit(pid, status); // 然后才唤醒等待的父进程
+    }
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// KillProcess
+// 	The current thread caused exception "which" (a system call that
+//	doesn't exist counts as a SyscallException).  Kill its program,
+//	unless that has been done already -- this may be one of its other
+//	threads faulting on the memory Kill took away -- and end the thread.
+//----------------------------------------------------------------------
+
+static void
+KillProcess(ExceptionType which)
+{
+    AddrSpace *space = currentThread->space;
+
+    if (!space->Killed())
+    {
+        printf("进程%d发生异常%d (PC=%d, 地址=%d)，已终止\n", space->getPid(),
+               which, machine->ReadRegister(PCReg),
+               machine->ReadRegister(BadVAddrReg));
+        space->Kill(FaultStatus + which);
+    }
+    ExitThread(FaultStatus + which);
+}
+
+#define MaxFileName 128 // Longest file name a user program can pass
+
+//----------------------------------------------------------------------
+// ReadUserString
+// 	Copy the null-terminated string at "addr" in user memory into a
+//	new kernel buffer, which the caller must delete.  Returns NULL if
+//	the string isn't all in the address space, or is longer than
+//	MaxFileName - 1.
+//----------------------------------------------------------------------
+
+static char *
+ReadUserString(int addr)
+{
+    char *str = new char[MaxFileName];
+
+    if (machine->CopyInString(addr, str, MaxFileName) < 0)
+    {
+        delete[] str;
+        return NULL;
+    }
+    return str;
+}
+
+//----------------------------------------------------------------------
+// UserConsole
+// 	Return the synchronous console behind ConsoleInput and
+//	ConsoleOutput, creating it the first time a program uses it.
+//----------------------------------------------------------------------
+
+static SynchConsole *
+UserConsole()
+{
+    if (synchConsole == NULL)
+        synchConsole = new SynchConsole(NULL, NULL);
+    return synchConsole;
+}
+
+//----------------------------------------------------------------------
+// UserPieces
+// 	Describe the user buffer of "size" bytes at "addr" by the pieces
+//	of mainMemory it occupies, one per page, so that a file can be read
+//	or written straight into or out of the frames.  The pieces go into
+//	"iov", which has room for MaxPieces(addr, size) of them (allocate
+//	that only once UserBufferOK has passed the buffer).  Return
+//	how many there are, or -1 if some page of the buffer isn't mapped
+//	(or is read-only, when "writing" into it).
+//
+//	The pieces are only good between AddrSpace::BeginIO and EndIO.
+//	Nothing pages the frames out, but another thread of the program
+//	may shrink the heap, unmap a file or be killed while the I/O
+//	blocks; the frames it gives up are only freed once the I/O is
+//	done, so that the transfer never lands in another program's page.
+//----------------------------------------------------------------------
+
+//----------------------------------------------------------------------
+// UserBufferOK
+// 	Return TRUE if the "size" bytes at "addr" are all in the current
+//	address space (and writable, when "writing" into them), bringing
+//	in pages that only get memory when first touched.  A transfer is
+//	checked this way before anything is allocated for it, so that a
+//	huge "size" can cost no more than the address space is big.
+//----------------------------------------------------------------------
+
+static bool
+UserBufferOK(int addr, int size, bool writing)
+{
+    int physAddr, chunk;
+
+    while (size > 0)
+    {
+        if (!machine->KernelTranslate(addr, &physAddr, writing))
+            return FALSE;
+        chunk = min(size, PageSize - (int)((unsigned)addr % PageSize));
+        addr += chunk;
+        size -= chunk;
+    }
+    return TRUE;
+}
+
+static int
+MaxPieces(int addr, int size)
+{
+    return divRoundUp((unsigned)addr % PageSize + size, PageSize);
+}
+
+static int
+UserPieces(int addr, int size, bool writing, IoVec *iov)
+{
+    int count = 0, physAddr, chunk;
+
+    while (size > 0)
+    {
+        if (!machine->KernelTranslate(addr, &physAddr, writing))
+            return -1;
+        chunk = min(size, PageSize - (int)((unsigned)addr % PageSize));
+        iov[count].base = &machine->mainMemory[physAddr];
+        iov[count].length = chunk;
+        count++;
+        addr += chunk;
+        size -= chunk;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// ReadUser, WriteUser
+// 	Read/write "size" bytes between the open file "fd" of the current
+//	address space and the user buffer at "addr".  Return the number of
+//	bytes read/written, or -1 if "fd" isn't open or the buffer isn't
+//	all in the address space.  The buffer is checked first, so what is
+//	allocated for the transfer is bounded by the address space.  The
+//	file is held (cf. AddrSpace::HoldFile) until the transfer is done,
+//	in case another thread of the program closes it meanwhile.
+//
+//	Files are read and written in one copy, straight between the
+//	buffer cache and the user's frames (cf. UserPieces).  The console,
+//	which moves a character at a time anyway, goes through a kernel
+//	buffer.
+//----------------------------------------------------------------------
+
+static int
+ReadUser(int fd, int addr, int size)
+{
+    AddrSpace *space = currentThread->space;
+    FileRef *ref = NULL;
+    IoVec *iov;
+    int count, numRead = -1;
+
+    if (size < 0 || (fd != ConsoleInput && (ref = space->HoldFile(fd)) == NULL))
+        return -1;
+    if (!UserBufferOK(addr, size, TRUE))
+    {
+        if (ref != NULL)
+            space->DropFile(ref);
+        return -1;
+    }
+    if (fd == ConsoleInput)
+    {
+        char *buffer = new char[size];
+        numRead = UserConsole()->Read(buffer, size);
+        if (!machine->CopyOut(buffer, addr, numRead))
+            numRead = -1; // 缓冲区不在地址空间内
+        delete[] buffer;
+        return numRead;
+    }
+    iov = new IoVec[MaxPieces(addr, size)];
+    space->BeginIO();
+    if ((count = UserPieces(addr, size, TRUE, iov)) >= 0)
+        numRead = ref->file->ReadV(iov, count);
+    space->EndIO();
+    delete[] iov;
+    space->DropFile(ref);
+    return numRead;
+}
+
+static int
+WriteUser(int fd, int addr, int size)
+{
+    AddrSpace *space = currentThread->space;
+    FileRef *ref = NULL;
+    IoVec *iov;
+    int count, numWritten = -1;
+
+    if (size < 0 || (fd != ConsoleOutput && (ref = space->HoldFile(fd)) == NULL))
+        return -1;
+    if (!UserBufferOK(addr, size, FALSE))
+    {
+        if (ref != NULL)
+            space->DropFile(ref);
+        return -1;
+    }
+    if (fd == ConsoleOutput)
+    {
+        char *buffer = new char[size];
+        if (machine->CopyIn(addr, buffer, size))
+        {
+            UserConsole()->Write(buffer, size);
+            numWritten = size;
+        }
+        delete[] buffer;
+        return numWritten;
+    }
+    iov = new IoVec[MaxPieces(addr, size)];
+    space->BeginIO();
+    if ((count = UserPieces(addr, size, FALSE, iov)) >= 0)
+        numWritten = ref->file->WriteV(iov, count);
+    space->EndIO();
+    delete[] iov;
+    space->DropFile(ref);
+    return numWritten;
+}
+
+//----------------------------------------------------------------------
+// CopyInWords
+// 	Copy "count" words at "addr" in user memory into "into", in host
+//	byte order.  Return FALSE if they aren't all in the address space.
+//----------------------------------------------------------------------
+
+static bool
+CopyInWords(int addr, int *into, int count)
+{
+    if (!machine->CopyIn(addr, (char *)into, count * sizeof(int)))
+        return FALSE;
+    for (int i = 0; i < count; i++)
+        into[i] = WordToHost(into[i]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ReadUserArgs
+// 	Copy the "argc" strings that the array at "argvAddr" in user memory
+//	points to into "into" (MaxArgSize bytes), one after another.  Return
+//	the bytes used, counting the terminators, or -1 if there are too
+//	many, or they don't all fit (none is cut short), or they aren't
+//	all in the address space.
+//----------------------------------------------------------------------
+
+static int
+ReadUserArgs(int argc, int argvAddr, char *into)
+{
+    int argv[MaxExecArgs];
+    int size = 0, length;
+
+    if (argc > MaxExecArgs || !CopyInWords(argvAddr, argv, argc))
+        return -1;
+    for (int i = 0; i < argc; i++)
+    {
+        if (size == MaxArgSize)
+            return -1;
+        length = machine->CopyInString(argv[i], into + size, MaxArgSize - size);
+        if (length < 0)
+            return -1;
+        size += length + 1;
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------
+// ExecProgram
+// 	Start the program whose name is at "nameAddr" in user memory as a
+//	new process, passing its main() the "argc" strings that the array
+//	at "argvAddr" points to (none if argc <= 0).  Return its PID, or -1
+//	if the name or the arguments can't be read, or the program can't
+//	be opened or loaded (cf. AddrSpace::Init).  The new process waits
+//	on the ready list; the caller goes on running.
+//----------------------------------------------------------------------
+
+static int
+ExecProgram(int nameAddr, int argc, int argvAddr)
+{
+    char *filename = ReadUserString(nameAddr); //读取文件名
+    char args[MaxArgSize]; //参数，一次读入
+    int argSize = 0;
+    OpenFile *executable;
+    AddrSpace *space = NULL;
+    Thread *thread;
+
+    if (argc < 0)
+        argc = 0;
+    if (filename == NULL || (argSize = ReadUserArgs(argc, argvAddr, args)) < 0)
+    {
+        delete[] filename;
+        return -1;
+    }
+    DEBUG('a', "执行程序:%s\n", filename);
+    executable = fileSystem->Open(filename);
+    if (executable != NULL)
+    {
+        space = new AddrSpace;
+        if (!space->Init(executable))
+        { // 不是可执行文件、内存不足或进程表已满
+            delete space;
+            space = NULL;
+        }
+        delete executable;
+    }
+    if (space == NULL)
+    {
+        printf("无法运行程序 %s\n", filename);
+        delete[] filename;
+        return -1;
+    }
+    if (argc > 0)
+        space->SetArguments(argc, args, argSize); //参数放在新程序的栈顶
+    thread = new Thread(filename);
+    thread->space = space;
+    thread->Fork(StartProcess, space->getPid());
+    return space->getPid();
+}
+
+//----------------------------------------------------------------------
+// TransferUserV
+// 	Like ReadUser/WriteUser ("reading" tells which), for the "count"
+//	IoVectors at "vecAddr".  The pieces of all the buffers are read or
+//	written in one request, so that it is atomic like a single Read or
+//	Write.  The console just takes the buffers one at a time (a read
+//	stops at the first one that isn't filled).
+//
+//	Every buffer is checked (cf. UserBufferOK) before the pieces are
+//	allocated: each is then no bigger than the address space, so
+//	neither the pieces nor the total length can run away.
+//----------------------------------------------------------------------
+
+static int
+TransferUserV(int fd, int vecAddr, int count, bool reading)
+{
+    AddrSpace *space = currentThread->space;
+    FileRef *ref;
+    int vec[2 * MaxIoVectors]; // buffer, size of each IoVector
+    IoVec *iov;
+    int i, n, pieces = 0, result = 0;
+
+    if (count < 0 || count > MaxIoVectors || !CopyInWords(vecAddr, vec, 2 * count))
+        return -1;
+    for (i = 0; i < count; i++)
+        if (vec[2 * i + 1] < 0)
+            return -1;
+    if (fd == (reading ? ConsoleInput : ConsoleOutput))
+    {
+        for (i = 0; i < count; i++)
+        {
+            n = reading ? ReadUser(fd, vec[2 * i], vec[2 * i + 1])
+                        : WriteUser(fd, vec[2 * i], vec[2 * i + 1]);
+            if (n < 0)
+                return -1;
+            result += n;
+            if (n < vec[2 * i + 1])
+                break;
+        }
+        return result;
+    }
+    if ((ref = space->HoldFile(fd)) == NULL)
+        return -1;
+    for (i = 0; i < count; i++)
+    {
+        if (!UserBufferOK(vec[2 * i], vec[2 * i + 1], reading))
+        {
+            space->DropFile(ref);
+            return -1; // 缓冲区不在地址空间内
+        }
+        pieces += MaxPieces(vec[2 * i], vec[2 * i + 1]);
+    }
+    iov = new IoVec[pieces];
+    space->BeginIO();
+    for (i = 0, pieces = 0; i < count; i++, pieces += n)
+        if ((n = UserPieces(vec[2 * i], vec[2 * i + 1], reading, &iov[pieces])) < 0)
+            break;
+    if (i < count)
+        result = -1; // 缓冲区不在地址空间内
+    else
+        result = reading ? ref->file->ReadV(iov, pieces) : ref->file->WriteV(iov, pieces);
+    space->EndIO();
+    delete[] iov;
+    space->DropFile(ref);
+    return result;
+}
+
+//----------------------------------------------------------------------
+// FileSyscall
+// 	Perform the file system call "type" (Create, Open, Read, Write,
+//	Close, ReadV or WriteV) with arguments "arg", as they would be in
+//	r4..r7, and return its result.  Used both for a single call and
+//	for each call of a batch.
+//----------------------------------------------------------------------
+
+static int
+FileSyscall(int type, int *arg)
+{
+    switch (type)
+    {
+    case SC_Create:
+    {
+        char *name = ReadUserString(arg[0]);
+        if (name == NULL)
+            return -1;
+        DEBUG('a', "执行Create系统调用，创建文件%s\n", name);
+        bool ok = fileSystem->Create(name, 0);
+        delete[] name;
+        return ok ? 0 : -1;
+    }
+    case SC_Open:
+    {
+        char *name = ReadUserString(arg[0]);
+        OpenFile *file = NULL;
+        int fd = -1;
+        if (name != NULL)
+        {
+            DEBUG('a', "执行Open系统调用，打开文件%s\n", name);
+            file = fileSystem->Open(name);
+            delete[] name;
+        }
+        if (file != NULL)
+        {
+            fd = currentThread->space->AddFile(file);
+            if (fd == -1)
+                delete file; // 描述符表已满
+        }
+        return fd;
+    }
+    case SC_Read:
+        DEBUG('a', "执行Read系统调用，从文件%d读%d字节\n", arg[2], arg[1]);
+        return ReadUser(arg[2], arg[0], arg[1]);
+    case SC_Write:
+        DEBUG('a', "执行Write系统调用，向文件%d写%d字节\n", arg[2], arg[1]);
+        return WriteUser(arg[2], arg[0], arg[1]);
+    case SC_ReadV:
+        DEBUG('a', "执行ReadV系统调用，从文件%d读%d段\n", arg[2], arg[1]);
+        return TransferUserV(arg[2], arg[0], arg[1], TRUE);
+    case SC_WriteV:
+        DEBUG('a', "执行WriteV系统调用，向文件%d写%d段\n", arg[2], arg[1]);
+        return TransferUserV(arg[2], arg[0], arg[1], FALSE);
+    case SC_Close:
+        DEBUG('a', "执行Close系统调用，关闭文件%d\n", arg[0]);
+        return currentThread->space->RemoveFile(arg[0]) ? 0 : -1;
+    default:
+        return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Batch
+// 	Perform the "count" SyscallDescs at "addr" in user memory, in
+//	order, in this one trap: the descriptors are read in at once, and
+//	written back, with their results, at once.  Stop at a call that
+//	isn't a file operation.  Return the number of calls performed, or
+//	-1 if the descriptors aren't all in the address space.
+//----------------------------------------------------------------------
+
+#define DescWords 6 // words in a SyscallDesc: code, arg[4], result
+
+static int
+Batch(int addr, int count)
+{
+    int desc[MaxBatch * DescWords];
+    int i;
+
+    if (count < 0 || count > MaxBatch || !CopyInWords(addr, desc, count * DescWords))
+        return -1;
+    DEBUG('a', "执行Batch系统调用，%d个调用\n", count);
+    for (i = 0; i < count; i++)
+    {
+        int *call = &desc[i * DescWords];
+        if (call[0] != SC_Create && call[0] != SC_Open && call[0] != SC_Read &&
+            call[0] != SC_Write && call[0] != SC_Close && call[0] != SC_ReadV &&
+            call[0] != SC_WriteV)
+            break;
+        call[5] = FileSyscall(call[0], &call[1]);
+    }
+    for (int j = 0; j < i * DescWords; j++)
+        desc[j] = WordToMachine(desc[j]);
+    if (!machine->CopyOut((char *)desc, addr, i * DescWords * sizeof(int)))
+        return -1;
+    return i;
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -61,43 +590,83 @@ void ExceptionHandler(ExceptionType which)
         case SC_Halt:
         {
             DEBUG('a', "执行Halt系统调用，停机\n");
+#ifdef FILESYS
+            fileSystem->Sync(); // 停机前提交文件系统的修改
+#endif
             interrupt->Halt();
             break;
         }
         case SC_Exec:
         {
             DEBUG('a', "执行Exec系统调用，运行新程序\n");
-            char *filename = new char[128];
-            int addr = machine->ReadRegister(4); //读取文件名地址
-            int i = 0;
-            do
-            {
-                machine->ReadMem(addr + i, 1, (int *)&filename[i]);
-            } while (filename[i++] != '\0');
-            DEBUG('a',"执行程序:%s\n", filename);
-            OpenFile *executable = fileSystem->Open(filename);
-            if (executable == NULL)
-            {
-                printf("无法打开程序 %s\n", filename);
-                AdvancePC();
-                return;
-            }
-            AddrSpace *space = new AddrSpace(executable);
-            delete executable;
-            Thread *thread = new Thread(filename);
-            thread->Fork(StartProcess, space->getPid());
-            thread->space = space;
-            machine->WriteRegister(2, space->getPid());
+            machine->WriteRegister(2, ExecProgram(machine->ReadRegister(4),
+                                                  machine->ReadRegister(5),
+                                                  machine->ReadRegister(6)));
+            AdvancePC();
+            // 不必让出CPU：新进程已在就绪队列中，父进程可以继续启动其他进程
+            break;
+        }
+        case SC_Join:
+        {
+            int pid = machine->ReadRegister(4);
+            DEBUG('a', "执行Join系统调用，等待进程%d退出\n", pid);
+            int status = processTable->Join(pid, currentThread->space->getPid());
+            machine->WriteRegister(2, status);
             AdvancePC();
-            currentThread->Yield();
             break;
         }
         case SC_Exit:
         {
-            DEBUG('a', "执行Exit系统调用，程序退出\n");
+            DEBUG('a', "执行Exit系统调用，线程退出\n");
             machine->WriteRegister(2, machine->ReadRegister(4));
             AdvancePC();
-            currentThread->Finish();
+            ExitThread(machine->ReadRegister(4));
+            break;
+        }
+        case SC_Fork:
+        {
+            // r4: 新线程执行的函数, r5: 函数返回后去的地址(start.s中)
+            AddrSpace *space = currentThread->space;
+            int slot = space->AddThread();
+            DEBUG('a', "执行Fork系统调用，新线程栈%d\n", slot);
+            if (slot != -1)
+            {
+                Thread *thread = new Thread("user thread");
+                thread->space = space;
+                thread->userStack = slot;
+                thread->SaveUserState(); // 从当前线程的寄存器开始
+                thread->SetUserRegister(PCReg, machine->ReadRegister(4));
+                thread->SetUserRegister(NextPCReg, machine->ReadRegister(4) + 4);
+                thread->SetUserRegister(RetAddrReg, machine->ReadRegister(5));
+                thread->SetUserRegister(StackReg, space->StackTop(slot));
+                thread->Fork(StartUserThread, 0);
+            }
+            machine->WriteRegister(2, slot == -1 ? -1 : 0);
+            AdvancePC();
+            break;
+        }
+        case SC_Sbrk:
+        {
+            int increment = machine->ReadRegister(4);
+            DEBUG('a', "执行Sbrk系统调用，堆增长%d字节\n", increment);
+            machine->WriteRegister(2, currentThread->space->Sbrk(increment));
+            AdvancePC();
+            break;
+        }
+        case SC_Mmap:
+        {
+            int fd = machine->ReadRegister(4);
+            DEBUG('a', "执行Mmap系统调用，映射文件%d\n", fd);
+            machine->WriteRegister(2, currentThread->space->Map(fd));
+            AdvancePC();
+            break;
+        }
+        case SC_Munmap:
+        {
+            int addr = machine->ReadRegister(4);
+            DEBUG('a', "执行Munmap系统调用，解除0x%x处的映射\n", addr);
+            machine->WriteRegister(2, currentThread->space->Unmap(addr) ? 0 : -1);
+            AdvancePC();
             break;
         }
         case SC_Yield:
@@ -106,22 +675,46 @@ void ExceptionHandler(ExceptionType which)
             currentThread->Yield();
             break;
         }
+        case SC_Create:
+        case SC_Open:
+        case SC_Read:
+        case SC_Write:
+        case SC_Close:
+        case SC_ReadV:
+        case SC_WriteV:
+        {
+            int arg[4];
+            for (int i = 0; i < 4; i++)
+                arg[i] = machine->ReadRegister(4 + i);
+            machine->WriteRegister(2, FileSyscall(type, arg));
+            AdvancePC();
+            break;
+        }
+        case SC_Batch:
+        {
+            int done = Batch(machine->ReadRegister(4), machine->ReadRegister(5));
+            machine->WriteRegister(2, done);
+            AdvancePC();
+            break;
+        }
         default:
-            printf("Unexpected user mode exception %d %d\n", which, type);
-            ASSERT(FALSE);
+            DEBUG('a', "未知的系统调用%d\n", type);
+            KillProcess(which); // 不返回
         }
     }
+    else if (which == PageFaultException &&
+             currentThread->space->Fault(machine->ReadRegister(BadVAddrReg)))
+        return; // 页已调入，重新执行该指令
     else
-    {
-        printf("Unexpected user mode exception %d %d\n", which, type);
-        ASSERT(FALSE);
-    }
+        KillProcess(which); // 终止出错的进程，不影响其他进程
 }
 
 void AdvancePC()
 {
     //前进PC
-    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
-    machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
-    machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg) + 4);
+    int nextPC = machine->registers[NextPCReg];
+
+    machine->registers[PrevPCReg] = machine->registers[PCReg];
+    machine->registers[PCReg] = nextPC;
+    machine->registers[NextPCReg] = nextPC + 4;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+// process.cc
+//	Routines to keep track of user processes, their parents and their
+//	exit status, for Join.  See process.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "process.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ProcessTable::ProcessTable
+// 	Initialize an empty process table.
+//----------------------------------------------------------------------
+
+ProcessTable::ProcessTable()
+{
+    lock = new Lock("process table");
+    for (int i = 0; i < MaxUserProcesses; i++)
+    {
+        table[i].inUse = FALSE;
+        table[i].done = new Condition("process done");
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::~ProcessTable
+// 	De-allocate the process table.
+//----------------------------------------------------------------------
+
+ProcessTable::~ProcessTable()
+{
+    for (int i = 0; i < MaxUserProcesses; i++)
+        delete table[i].done;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Add
+// 	Enter a new process in the table, taking a free PID for it from
+//	machine->threadMap.  Return the PID, or -1 if there is none free.
+//
+//	"parent" -- PID of the process creating it, or NoParent
+//----------------------------------------------------------------------
+
+int
+ProcessTable::Add(int parent)
+{
+    int pid;
+
+    lock->Acquire();
+    pid = machine->threadMap->Find();
+    if (pid != -1)
+    {
+        table[pid].inUse = TRUE;
+        table[pid].parent = parent;
+        table[pid].exited = FALSE;
+        table[pid].exitStatus = 0;
+    }
+    lock->Release();
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Exit
+// 	Record that process "pid" has exited with "status", and wake up
+//	its parent if it is waiting in Join.  Its children no longer have
+//	a parent to join them: those that have exited already are freed,
+//	and the others will be when they exit.  So is "pid" itself, if
+//	nobody can join it.
+//----------------------------------------------------------------------
+
+void
+ProcessTable::Exit(int pid, int status)
+{
+    lock->Acquire();
+    ASSERT(table[pid].inUse && !table[pid].exited);
+    table[pid].exited = TRUE;
+    table[pid].exitStatus = status;
+    for (int i = 0; i < MaxUserProcesses; i++)
+        if (table[i].inUse && table[i].parent == pid)
+        {
+            if (table[i].exited)
+                Free(i);
+            else
+                table[i].parent = NoParent;
+        }
+    if (table[pid].parent == NoParent)
+        Free(pid);
+    else
+        table[pid].done->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Join
+// 	Wait until process "pid" has exited, then free its PID and return
+//	its exit status.  Return -1 at once if "pid" isn't a child of
+//	"parent" (or has been joined already).
+//----------------------------------------------------------------------
+
+int
+ProcessTable::Join(int pid, int parent)
+{
+    int status = -1;
+
+    if (pid < 0 || pid >= MaxUserProcesses)
+        return -1;
+    lock->Acquire();
+    while (table[pid].inUse && table[pid].parent == parent &&
+           !table[pid].exited)
+        table[pid].done->Wait(lock);
+    if (table[pid].inUse && table[pid].parent == parent)
+    {
+        status = table[pid].exitStatus;
+        Free(pid);
+    }
+    lock->Release();
+    return status;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Free
+// 	Forget process "pid", and give its PID back to machine->threadMap.
+//	The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+ProcessTable::Free(int pid)
+{
+    table[pid].inUse = FALSE;
+    machine->threadMap->Clear(pid);
+}
@@ -0,0 +1,60 @@
+// process.h
+//	Data structures for the kernel's table of user processes.
+//
+//	A process is known by its PID, the bit it holds in
+//	machine->threadMap.  The table records who created each process,
+//	so that only its parent can Join it, and the status it exited
+//	with, which Join returns.
+//
+//	As in UNIX, a process that has exited keeps its PID until its
+//	parent has joined it (it is a "zombie"); otherwise a later process
+//	could be given the PID, and be joined by mistake.  A process whose
+//	parent has exited (or that has no parent: the first program) has
+//	nobody to join it, so its PID is freed as soon as it exits.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "machine.h"
+#include "synch.h"
+
+#define NoParent -1		// PID of the parent of the first program
+
+// The following class defines an entry of the table: one process.
+class Process {
+  public:
+    bool inUse;			// Does a process have this PID?
+    int parent;			// PID of its parent, or NoParent
+    bool exited;		// Has it called Exit?
+    int exitStatus;		// What it passed to Exit
+    Condition *done;		// Signalled when it exits
+};
+
+class ProcessTable {
+  public:
+    ProcessTable();		// Initialize an empty table
+    ~ProcessTable();		// De-allocate the table
+
+    int Add(int parent);	// Give a new process, child of "parent",
+				// a PID (-1 if there is none left)
+    void Exit(int pid, int status);
+				// Process "pid" has exited with "status"
+    int Join(int pid, int parent);
+				// Wait for "pid", a child of "parent", to
+				// exit; return its status (-1 if it isn't
+				// a child)
+
+  private:
+    Process table[MaxUserProcesses];
+    Lock *lock;			// Protects the table
+
+    void Free(int pid);		// Give the PID back
+};
+
+#endif // PROCESS_H
@@ -30,7 +30,14 @@ void StartProcess(char *filename)
         printf("Unable to open file %s\n", filename);
         return;
     }
-    space = new AddrSpace(executable);
+    space = new AddrSpace;
+    if (!space->Init(executable))
+    {
+        printf("Unable to run file %s\n", filename);
+        delete space;
+        delete executable;
+        return;
+    }
     currentThread->space = space;
     space->Print();
     delete executable; // close file
@@ -46,7 +53,8 @@ void StartProcess(char *filename)
 }
 
 void StartProcess(int spaceId){
-    currentThread->space->Print();
+    if (DebugIsEnabled('a'))
+        currentThread->space->Print(); // 打印页表较慢，只在调试时打印
     currentThread->space->RestoreState();
     currentThread->space->InitRegisters();
     machine->Run(); 
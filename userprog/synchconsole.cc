@@ -0,0 +1,137 @@
+// synchconsole.cc 
+//	Routines to synchronously access the console.  The console is an
+//	asynchronous device (requests return immediately, and an interrupt
+//	happens later on).  This is a layer on top of the console providing
+//	a synchronous interface (requests wait until they are done).
+//
+//	As with the disk, we use a semaphore to synchronize each request
+//	with its interrupt, and a lock so that only one thread at a time
+//	reads (or writes) the console.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchconsole.h"
+
+//----------------------------------------------------------------------
+// ConsoleReadAvail, ConsoleWriteDone
+// 	Console interrupt handlers.  Need these to be C routines, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ConsoleReadAvail(_int arg)
+{
+    SynchConsole *console = (SynchConsole *)arg;
+
+    console->ReadAvail();
+}
+
+static void
+ConsoleWriteDone(_int arg)
+{
+    SynchConsole *console = (SynchConsole *)arg;
+
+    console->WriteDone();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::SynchConsole
+// 	Initialize the synchronous interface to the console, in turn
+//	initializing the raw console.
+//
+//	"readFile", "writeFile" -- UNIX files simulating the keyboard and
+//	the display (NULL for stdin and stdout)
+//----------------------------------------------------------------------
+
+SynchConsole::SynchConsole(char *readFile, char *writeFile)
+{
+    readAvail = new Semaphore("console read avail", 0);
+    writeDone = new Semaphore("console write done", 0);
+    readLock = new Lock("console read lock");
+    writeLock = new Lock("console write lock");
+    console = new Console(readFile, writeFile, ConsoleReadAvail,
+                          ConsoleWriteDone, (_int)this);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	De-allocate data structures needed for the synchronous console
+//	abstraction.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
+    delete writeLock;
+    delete readLock;
+    delete writeDone;
+    delete readAvail;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Read characters typed at the keyboard into "into", until there
+//	are "numBytes" of them or a newline has been read (the newline is
+//	kept, as in UNIX).  Waits for the first character; returns 0 if the
+//	input has ended.
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *into, int numBytes)
+{
+    int numRead = 0;
+    char ch;
+
+    readLock->Acquire();
+    while (numRead < numBytes)
+    {
+        readAvail->P();			// wait for a character to arrive
+        ch = console->GetChar();
+        if (ch == EOF)
+            break;			// end of the input file
+        into[numRead++] = ch;
+        if (ch == '\n')
+            break;
+    }
+    readLock->Release();
+    return numRead;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Write "numBytes" characters from "from" to the display, one at a
+//	time, waiting for each to be written.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *from, int numBytes)
+{
+    writeLock->Acquire();
+    for (int i = 0; i < numBytes; i++)
+    {
+        console->PutChar(from[i]);
+        writeDone->P();			// wait for the interrupt
+    }
+    writeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail, SynchConsole::WriteDone
+// 	Console interrupt handlers.  Wake up the thread waiting for a
+//	character to arrive, or to be written.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    readAvail->V();
+}
+
+void
+SynchConsole::WriteDone()
+{
+    writeDone->V();
+}
@@ -0,0 +1,53 @@
+// synchconsole.h 
+// 	Data structures to export a synchronous interface to the raw 
+//	console device, for the ConsoleInput and ConsoleOutput files of
+//	user programs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SYNCHCONSOLE_H
+#define SYNCHCONSOLE_H
+
+#include "console.h"
+#include "synch.h"
+
+// The following class defines a "synchronous" console abstraction.
+// Like the disk, the raw console is asynchronous -- PutChar returns
+// before the character is written, and an interrupt says when a
+// character has arrived.  Here, a thread waits until its characters
+// are written, or until there is something to read.
+//
+// Reads and writes are done a whole request at a time: the characters
+// of one Write are never mixed up with those of another thread's.
+class SynchConsole {
+  public:
+    SynchConsole(char *readFile, char *writeFile);
+    					// Initialize a synchronous console,
+					// by initializing the raw Console
+					// (NULL means stdin/stdout)
+    ~SynchConsole();			// De-allocate the synch console data
+
+    int Read(char *into, int numBytes);	// Read up to "numBytes" characters,
+					// waiting for at least one; stop
+					// after a newline.  Return the #
+					// read (0 at the end of the input)
+    void Write(char *from, int numBytes);
+    					// Write "numBytes" characters,
+					// returning once they are written
+
+    void ReadAvail();			// Called by the console interrupt
+    void WriteDone();			// handlers
+
+  private:
+    Console *console;			// Raw console device
+    Semaphore *readAvail;		// A character has arrived
+    Semaphore *writeDone;		// A character has been written
+    Lock *readLock;			// One Read at a time
+    Lock *writeLock;			// One Write at a time
+};
+
+#endif // SYNCHCONSOLE_H
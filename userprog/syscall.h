@@ -29,6 +29,12 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_ReadV	11
+#define SC_WriteV	12
+#define SC_Batch	13
+#define SC_Sbrk		14
+#define SC_Mmap		15
+#define SC_Munmap	16
 
 #ifndef IN_ASM
 
@@ -52,13 +58,25 @@ void Halt();
 /* This user program is done (status = 0 means exited normally). */
 void Exit(int status);	
 
+/* A program that causes an exception -- an address error, an illegal
+ * instruction, an unknown system call, ... -- is killed, and exits with
+ * status FaultStatus plus the number of the exception (see machine.h).
+ */
+#define FaultStatus	256
+
 /* A unique identifier for an executing user program (address space) */
 typedef int SpaceId;	
  
 /* Run the executable, stored in the Nachos file "name", and return the 
- * address space identifier
+ * address space identifier (-1 if it can't be run).  The "argc" strings
+ * in "argv" are copied onto the new program's stack, and passed to its
+ * main() as argc and argv; argc <= 0 passes none.
  */
-SpaceId Exec(char *name);
+SpaceId Exec(char *name, int argc, char **argv);
+
+#define MaxExecArgs	16	/* most arguments Exec passes */
+#define MaxArgSize	256	/* most bytes of argument strings, counting
+				 * their terminators */
  
 /* Only return once the the user program "id" has finished.  
  * Return the exit status.
@@ -66,6 +84,14 @@ SpaceId Exec(char *name);
 int Join(SpaceId id); 	
  
 
+/* Memory allocation: move the end of the program's heap by "increment"
+ * bytes (UNIX sbrk), and return where it was, or -1 if it can't move.
+ * The heap starts empty, above the program and its stacks; its pages
+ * only take up memory once they are used.
+ */
+char *Sbrk(int increment);
+
+
 /* File system operations: Create, Open, Read, Write, Close
  * These functions are patterned after UNIX -- files represent
  * both files *and* hardware I/O devices.
@@ -87,16 +113,21 @@ typedef int OpenFileId;
 #define ConsoleInput	0  
 #define ConsoleOutput	1  
  
-/* Create a Nachos file, with "name" */
-void Create(char *name);
+/* Create a Nachos file, with "name".  Return 0, or -1 if it can't be
+ * created.
+ */
+int Create(char *name);
 
 /* Open the Nachos file "name", and return an "OpenFileId" that can 
  * be used to read and write to the file.
  */
 OpenFileId Open(char *name);
 
-/* Write "size" bytes from "buffer" to the open file. */
-void Write(char *buffer, int size, OpenFileId id);
+/* Write "size" bytes from "buffer" to the open file.  Return the number
+ * of bytes written, or -1 if "id" isn't open or "buffer" isn't all in
+ * the address space.
+ */
+int Write(char *buffer, int size, OpenFileId id);
 
 /* Read "size" bytes from the open file into "buffer".  
  * Return the number of bytes actually read -- if the open file isn't
@@ -109,6 +140,57 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* One buffer of a scattered read or write. */
+typedef struct {
+    char *buffer;
+    int size;
+} IoVector;
+
+#define MaxIoVectors	16	/* most buffers ReadV and WriteV take */
+
+/* Read from (write to) the open file into (from) the "count" buffers
+ * of "iov" in turn, as one operation.  Return the number of bytes 
+ * actually read (written), or -1 on error.
+ */
+int ReadV(IoVector *iov, int count, OpenFileId id);
+int WriteV(IoVector *iov, int count, OpenFileId id);
+
+/* One system call of a batch: "code" is its SC_ code, "arg" its
+ * arguments, and the kernel puts what it returns into "result".
+ */
+typedef struct {
+    int code;
+    int arg[4];
+    int result;
+} SyscallDesc;
+
+#define MaxBatch	32	/* most calls in one batch */
+
+/* Perform the "count" system calls of "calls" in order, trapping to 
+ * the kernel only once.  Only the file operations (Create, Open, Read, 
+ * Write, Close, ReadV, WriteV) can be batched; the batch stops at any 
+ * other.  Return the number of calls performed, or -1 if "calls" 
+ * can't be read.
+ */
+int Batch(SyscallDesc *calls, int count);
+
+
+
+/* Map the open file "id" into the address space, and return the 
+ * address where its first byte is (0 if it can't be mapped).  Pages are
+ * read from the file as the program touches them; the file can then
+ * be read and written like memory, without system calls.  It stays
+ * mapped if "id" is closed.
+ */
+char *Mmap(OpenFileId id);
+
+/* Unmap the file mapped at "addr", writing what was changed back to
+ * the file.  Files still mapped at Exit are unmapped the same way.
+ * The file doesn't grow: only its length when it was mapped is mapped.
+ * Return 0, or -1 if no file is mapped at "addr".
+ */
+int Munmap(char *addr);
+
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
@@ -116,9 +198,14 @@ void Close(OpenFileId id);
  */
 
 /* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+ * as the current thread, on a stack of its own.  When "func" returns,
+ * the thread exits, as if it called Exit(0).  Exit ends only the thread
+ * calling it; the program is done when its last thread exits, and the
+ * status of that Exit is what Join returns.  Return 0, or -1 if the
+ * program has MaxUserThreads threads already (cf. addrspace.h), or
+ * memory is short.
  */
-void Fork(void (*func)());
+int Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 